@@ -25,6 +25,7 @@ using weos::semaphore;
 
 // thread.hpp
 using weos::thread;
+namespace this_thread = weos::this_thread;
 
 } // namespace OperatingSystem
 
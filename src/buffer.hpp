@@ -22,6 +22,7 @@ namespace uNet
 {
 
 class BufferBase;
+class BufferMemento;
 
 //! A buffer grabber.
 //! A BufferGrabber is an object which can take the ownership of a Buffer
@@ -34,6 +35,18 @@ public:
     virtual void grab(BufferBase& buffer) = 0;
 };
 
+//! A memento disposer.
+//! This abstract base class specifies the interface of a disposer for a
+//! BufferMemento. A memento which has been allocated from a pool holds a
+//! pointer to its disposer, which returns it to the pool when the memento is
+//! removed from the buffer.
+class BufferMementoDisposer
+{
+public:
+    //! Disposes the given \p memento.
+    virtual void dispose(BufferMemento* memento) = 0;
+};
+
 //! A memento for storing some buffer state.
 //! The BufferMemento can---to a certain degree---save and restore the state of
 //! a Buffer. It does not memorize the buffer's data but only the current
@@ -56,20 +69,26 @@ public:
     //! A helper class for disposing a BufferMemento.
     class Disposer
     {
-        void operator() (BufferMemento* memento)
+    public:
+        void operator() (BufferMemento* memento) const
         {
-            //memento->m_pool.destroy(memento);
+            if (memento->m_disposer)
+                memento->m_disposer->dispose(memento);
         }
     };
 
     //! Creates a buffer memento.
     //! Creates a buffer memento which will return the buffer to the \p grabber
-    //! instead of disposing it.
+    //! instead of disposing it. When the memento is removed from the buffer,
+    //! it is handed over to the \p disposer. The disposer may be a
+    //! null-pointer, if the memento is not allocated from a pool.
     //! \todo Take the buffer as argument here?
-    explicit BufferMemento(BufferGrabber* grabber)
+    explicit BufferMemento(BufferGrabber* grabber,
+                           BufferMementoDisposer* disposer = 0)
         : m_grabber(grabber),
           m_begin(0),
-          m_end(0)
+          m_end(0),
+          m_disposer(disposer)
     {
     }
 
@@ -89,8 +108,8 @@ public:
     memento_list_hook_t m_mementoListHook;
 
 private:
-    //! A pointer back to the pool from which this hook was allocated.
-    void* m_pool;
+    //! The object to which the memento is returned after use.
+    BufferMementoDisposer* m_disposer;
 
     friend class BufferBase;
 };
@@ -126,19 +145,49 @@ public:
     virtual void dispose(BufferBase* buffer) = 0;
 };
 
+//! A buffer allocator.
+//! This abstract base class specifies the interface of an object from which
+//! buffers can be allocated, e.g. a BufferPool.
+class BufferAllocator
+{
+public:
+    //! Allocates a buffer.
+    //! Allocates a buffer and returns a pointer to it. The calling thread
+    //! is blocked until a buffer is available.
+    virtual BufferBase* allocate() = 0;
+
+    //! Tries to allocate a buffer.
+    //! Allocates a buffer and returns a pointer to it. If no buffer is
+    //! available, a null-pointer is returned.
+    virtual BufferBase* try_allocate() = 0;
+};
+
 //! The common base of all buffers.
 //! The BufferBase is the common base class of all buffer implementations
 //! in the uNet library.
 class BufferBase : boost::noncopyable
 {
-    static const unsigned numReservedBytes = 32;
 public:
+    //! The default number of bytes which are reserved in front of the data
+    //! of a new buffer. This space is used for prepending the headers.
+    static const unsigned defaultHeadroom = 32;
 
-    explicit BufferBase(std::uint8_t* storageBegin,
-                        BufferDisposer* disposer = 0)
-        : m_disposer(disposer)
+    //! Creates a buffer.
+    //! Creates a buffer whose storage of \p storageSize bytes starts at
+    //! \p storageBegin. The buffer will be destroyed via the \p disposer.
+    //! The first \p headroom bytes of the storage are reserved for
+    //! prepending headers.
+    BufferBase(std::uint8_t* storageBegin, std::size_t storageSize,
+               BufferDisposer* disposer = 0,
+               std::size_t headroom = defaultHeadroom)
+        : m_storageBegin(storageBegin),
+          m_storageEnd(storageBegin + storageSize),
+          m_disposer(disposer),
+          m_nextSegment(0),
+          m_headroom(headroom)
     {
-        m_begin = m_end = storageBegin + numReservedBytes;
+        UNET_ASSERT(storageSize >= headroom);
+        m_begin = m_end = storageBegin + headroom;
     }
 
     virtual ~BufferBase() {}
@@ -174,7 +223,14 @@ public:
     //! Clears the buffer.
     void clear()
     {
-        m_begin = m_end = storageBegin() + numReservedBytes;
+        m_begin = m_end = storageBegin() + m_headroom;
+    }
+
+    //! Returns the number of bytes which a cleared buffer reserves in front
+    //! of the data.
+    std::size_t headroom() const
+    {
+        return m_headroom;
     }
 
     //! Returns the buffer disposer.
@@ -183,25 +239,72 @@ public:
         return m_disposer;
     }
 
+    //! Sets the buffer disposer.
+    //! Sets the \p disposer which is invoked when the buffer is disposed.
+    void setDisposer(BufferDisposer* disposer)
+    {
+        m_disposer = disposer;
+    }
+
     //! Disposes the buffer.
-    //! If there is still a memento on the memento stack, the buffer is returned
+    //! If the buffer is shared, only one reference is dropped. Otherwise, if
+    //! there is still a memento on the memento stack, the buffer is returned
     //! to the top-most memento (the one which has been last recently added).
-    //! Otherwise, the buffer is handled over to the disposer.
+    //! Otherwise, the buffer is handled over to the disposer together with
+    //! all segments which follow it.
     void dispose()
     {
+        if (m_referenceCounter.tryDec())
+            return;
+
         if (!m_mementoStack.empty())
         {
             BufferMemento& memento = m_mementoStack.front();
             m_begin = memento.m_begin;
             m_end = memento.m_end;
             BufferGrabber* grabber = memento.m_grabber;
-            m_mementoStack.pop_front();//! \todo should be popfront_and_dispose()
+            m_mementoStack.pop_front_and_dispose(BufferMemento::Disposer());
             grabber->grab(*this);
         }
-        else if (m_disposer)
-            m_disposer->dispose(this);
         else
-            delete this;
+        {
+            BufferBase* next = m_nextSegment;
+            m_nextSegment = 0;
+            if (m_disposer)
+                m_disposer->dispose(this);
+            else
+                delete this;
+            if (next)
+                next->dispose();
+        }
+    }
+
+    //! Returns the next segment.
+    //! A packet which does not fit into a single buffer is stored in a chain
+    //! of buffers (segments). This method returns the segment which follows
+    //! this buffer or a null-pointer, if this is the last segment.
+    BufferBase* nextSegment() const
+    {
+        return m_nextSegment;
+    }
+
+    //! Sets the next segment.
+    //! Links the \p segment behind this buffer. The segment is disposed
+    //! together with this buffer.
+    void setNextSegment(BufferBase* segment)
+    {
+        m_nextSegment = segment;
+    }
+
+    //! Shares the buffer.
+    //! Adds \p count references to the buffer. Every reference has to be
+    //! dropped with dispose() and the buffer is only handed over to its
+    //! disposer when the last reference is gone. The owners of a shared
+    //! buffer must not modify it.
+    void share(unsigned count = 1)
+    {
+        for (; count; --count)
+            m_referenceCounter.inc();
     }
 
     //! Returns a pointer to the beginning of the data.
@@ -234,6 +337,12 @@ public:
         return m_end;
     }
 
+    void moveEnd(int offset)
+    {
+        m_end += offset;
+        UNET_ASSERT(m_end >= m_begin && m_end <= storageEnd());
+    }
+
     //! Copies an element from the beginning of the buffer.
     //! Copies an element of type \p TType from the beginning of the buffer
     //! without changing the iterators.
@@ -279,6 +388,43 @@ public:
         std::memcpy(m_begin, &data, sizeof(TType));
     }
 
+    //! Appends data to the buffer.
+    //! Copies \p size bytes from \p data to the end of the buffer.
+    void append(const void* data, std::size_t size)
+    {
+        UNET_ASSERT(size <= back_capacity());
+        std::memcpy(m_end, data, size);
+        m_end += size;
+    }
+
+    //! Extracts data from the beginning of the buffer.
+    //! Copies \p size bytes from the beginning of the buffer to \p data and
+    //! advances the start iterator.
+    void extract_front(void* data, std::size_t size)
+    {
+        UNET_ASSERT(size <= this->size());
+        std::memcpy(data, m_begin, size);
+        m_begin += size;
+    }
+
+    //! Copies data from the buffer.
+    //! Copies \p size bytes which start \p offset bytes past the begin
+    //! iterator to \p data without changing the iterators.
+    void peek(std::size_t offset, void* data, std::size_t size) const
+    {
+        UNET_ASSERT(offset <= this->size() && size <= this->size() - offset);
+        std::memcpy(data, m_begin + offset, size);
+    }
+
+    //! Prepends data to the buffer.
+    //! Copies \p size bytes from \p data to the front of the buffer.
+    void prepend(const void* data, std::size_t size)
+    {
+        UNET_ASSERT(size <= front_capacity());
+        m_begin -= size;
+        std::memcpy(m_begin, data, size);
+    }
+
     //! Places the begin and end iterators to the beginning of the storage.
     void rewind()
     {
@@ -293,21 +439,52 @@ public:
         return static_cast<std::size_t>(m_end - m_begin);
     }
 
+    //! Returns the total size of the data.
+    //! Returns the size of the data in this buffer and in all segments which
+    //! follow it.
+    std::size_t totalSize() const
+    {
+        std::size_t total = 0;
+        for (const BufferBase* segment = this; segment;
+             segment = segment->m_nextSegment)
+        {
+            total += segment->size();
+        }
+        return total;
+    }
+
 protected:
     //! Returns a pointer to the first byte of the storage.
-    virtual std::uint8_t* storageBegin() const = 0;
+    std::uint8_t* storageBegin() const
+    {
+        return m_storageBegin;
+    }
+
     //! Returns a pointer just past the last byte of the storage.
-    virtual std::uint8_t* storageEnd() const = 0;
+    std::uint8_t* storageEnd() const
+    {
+        return m_storageEnd;
+    }
 
 private:
     //! Points to the first valid byte in the storage.
     std::uint8_t* m_begin;
     //! Points just past the last valid byte in the storage.
     std::uint8_t* m_end;
+    //! Points to the first byte of the storage. The bounds of the storage
+    //! are stored in the buffer such that the accesses to the data need no
+    //! virtual function calls.
+    std::uint8_t* m_storageBegin;
+    //! Points just past the last byte of the storage.
+    std::uint8_t* m_storageEnd;
     //! The object which is invoked for disposing this buffer.
     BufferDisposer* m_disposer;
     //! A stack for storing the mementos.
     BufferMementoStack m_mementoStack;
+    //! The next segment of a chained packet.
+    BufferBase* m_nextSegment;
+    //! The number of bytes which are reserved in front of the data.
+    std::uint16_t m_headroom;
 
     ReferenceCounter m_referenceCounter;
 
@@ -374,25 +551,15 @@ public:
     //! Creates a buffer.
     //! Creates a buffer which will be destroyed via the buffer \p disposer.
     //! The disposer may be a null-pointer in which case it is never invoked.
-    explicit Buffer(BufferDisposer* disposer = 0)
-        : BufferBase(static_cast<std::uint8_t*>(m_data.address()), disposer),
+    //! The first \p headroom bytes are reserved for prepending headers.
+    explicit Buffer(BufferDisposer* disposer = 0,
+                    std::size_t headroom = defaultHeadroom)
+        : BufferBase(static_cast<std::uint8_t*>(m_data.address()),
+                     TBufferSize, disposer, headroom),
           m_processorStackSize(0)
     {
     }
 
-protected:
-    //! \reimp
-    virtual std::uint8_t* storageBegin() const
-    {
-        return static_cast<std::uint8_t*>(m_data.address());
-    }
-
-    //! \reimp
-    virtual std::uint8_t* storageEnd() const
-    {
-        return static_cast<std::uint8_t*>(m_data.address()) + TBufferSize;
-    }
-
 private:
     //! The storage of the buffer.
     typename boost::aligned_storage<TBufferSize>::type m_data;
@@ -402,6 +569,45 @@ private:
     std::size_t m_processorStackSize;
 };
 
+//! A buffer with external storage.
+//! The ExternalBuffer wraps memory which is owned by somebody else, e.g. a
+//! slot in the DMA ring of a network driver. This allows a driver to pass a
+//! received frame to the kernel without copying it into a pool buffer.
+//!
+//! When the buffer is disposed, its \p disposer is invoked like for any
+//! other buffer. The disposer of a driver would typically hand the slot
+//! back to the hardware. Mementos and reference counts work as usual.
+class ExternalBuffer : public BufferBase
+{
+public:
+    //! Creates an external buffer.
+    //! Creates a buffer which wraps the \p storageSize bytes at \p storage.
+    //! The buffer is empty and \p headroom bytes are reserved for prepending
+    //! headers. The \p disposer is invoked when the buffer is disposed.
+    ExternalBuffer(std::uint8_t* storage, std::size_t storageSize,
+                   BufferDisposer* disposer, std::size_t headroom = 0)
+        : BufferBase(storage, storageSize, disposer, headroom)
+    {
+    }
+
+    //! Returns a pointer to the first byte of the storage.
+    std::uint8_t* storage() const
+    {
+        return storageBegin();
+    }
+
+    //! Sets the data.
+    //! Marks the \p size bytes which start \p offset bytes past the
+    //! beginning of the storage as valid data. A driver calls this method
+    //! when it has received a frame into the storage.
+    void setData(std::size_t offset, std::size_t size)
+    {
+        rewind();
+        moveEnd(offset + size);
+        moveBegin(offset);
+    }
+};
+
 } // namespace uNet
 
 #endif // UNET_BUFFER_HPP
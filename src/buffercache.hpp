@@ -0,0 +1,453 @@
+#ifndef UNET_BUFFERCACHE_HPP
+#define UNET_BUFFERCACHE_HPP
+
+#include "config.hpp"
+
+#include "buffer.hpp"
+#include "segregatedbufferpool.hpp"
+
+#include <boost/mpl/begin_end.hpp>
+#include <boost/mpl/next.hpp>
+#include <boost/static_assert.hpp>
+#include <boost/utility.hpp>
+
+#include <atomic>
+
+namespace uNet
+{
+
+//! A cache of free buffers.
+//! The BufferCache is a small magazine of free buffers in front of a
+//! BufferPool. It is owned by a single thread, e.g. the receive thread of an
+//! interface, which allocates its buffers from the cache instead of the
+//! pool. Thus, the owner does not contend with other threads for the
+//! pool's lock.
+//!
+//! The cache is the disposer of the buffers which it hands out. A buffer
+//! may be disposed from any thread. It is pushed onto a lock-free stack of
+//! returned buffers, from which the owner refills its magazine in one go.
+//! If the stack already holds \p TCacheSize buffers, further buffers are
+//! returned to the pool directly. When both the magazine and the stack are
+//! empty, a batch of buffers is fetched from the pool. If the pool is empty,
+//! too, allocate() blocks on the pool. While the owner is blocked, disposed
+//! buffers are released to the pool instead of the cache, such that they
+//! wake the owner up. Note that the buffers in a cache are accounted as
+//! allocated in the pool's statistics.
+//!
+//! The pool \p TPool must be a plain BufferPool. A SegregatedBufferPool is
+//! cached by a SegregatedBufferCache.
+//!
+//! The cache must outlive all buffers which have been allocated from it.
+template <typename TPool, unsigned TCacheSize>
+class BufferCache : public BufferAllocator,
+                    public BufferDisposer,
+                    boost::noncopyable
+{
+    BOOST_STATIC_ASSERT(TCacheSize > 0);
+
+public:
+    //! The type of the buffers in the cache.
+    typedef typename TPool::buffer_type buffer_type;
+
+    //! Creates an empty cache in front of the \p pool.
+    explicit BufferCache(TPool& pool)
+        : m_pool(pool),
+          m_numCached(0),
+          m_returned(0),
+          m_numReturned(0),
+          m_ownerWaiting(false)
+    {
+    }
+
+    //! Destroys the cache and returns all cached buffers to the pool.
+    ~BufferCache()
+    {
+        flush();
+    }
+
+    //! Allocates a buffer.
+    //! Allocates a buffer from the cache. If the cache is empty, it is
+    //! refilled from the pool. If the pool is empty, the calling thread is
+    //! blocked until a buffer has been released. This method must only be
+    //! called by the owner of the cache.
+    virtual buffer_type* allocate()
+    {
+        if (m_numCached == 0)
+            refill();
+        if (m_numCached)
+            return m_cached[--m_numCached];
+
+        // Announce that the owner is going to block on the pool and look
+        // for returned buffers once more. A buffer which is disposed from
+        // now on is either found here or released to the pool by dispose().
+        m_ownerWaiting.store(true);
+        collectReturnedBuffers();
+        if (m_numCached)
+        {
+            m_ownerWaiting.store(false);
+            return m_cached[--m_numCached];
+        }
+        buffer_type* buffer = m_pool.allocate();
+        m_ownerWaiting.store(false);
+        return adopt(buffer);
+    }
+
+    //! Returns the number of buffers in the cache.
+    unsigned size() const
+    {
+        return m_numCached + m_numReturned.load(std::memory_order_relaxed);
+    }
+
+    //! Flushes the cache.
+    //! Returns all buffers in the cache to the pool. This method must only be
+    //! called by the owner of the cache.
+    void flush()
+    {
+        collectReturnedBuffers();
+        while (m_numCached)
+            m_pool.release(m_cached[--m_numCached]);
+    }
+
+    //! Tries to allocate a buffer.
+    //! Allocates a buffer from the cache. If the cache is empty, it is
+    //! refilled from the pool. If no buffer is available, a null-pointer is
+    //! returned. This method must only be called by the owner of the cache.
+    virtual buffer_type* try_allocate()
+    {
+        if (m_numCached == 0)
+            refill();
+        if (m_numCached == 0)
+            return 0;
+        return m_cached[--m_numCached];
+    }
+
+protected:
+    //! \reimp
+    //! This method may be called from any thread.
+    virtual void dispose(BufferBase* buffer)
+    {
+        if (m_numReturned.fetch_add(1, std::memory_order_relaxed)
+            >= TCacheSize)
+        {
+            m_numReturned.fetch_sub(1, std::memory_order_relaxed);
+            m_pool.release(static_cast<buffer_type*>(buffer));
+            return;
+        }
+
+        // The returned buffers are linked via their next segment pointer,
+        // which is unused while a buffer is free.
+        BufferBase* head = m_returned.load(std::memory_order_relaxed);
+        do
+        {
+            buffer->setNextSegment(head);
+        } while (!m_returned.compare_exchange_weak(head, buffer));
+
+        // If the owner is blocked on the pool, it does not see the returned
+        // buffers. Hand them over to the pool instead.
+        if (m_ownerWaiting.load())
+            releaseReturnedBuffers();
+    }
+
+private:
+    //! The number of buffers which are fetched from the pool at once.
+    static const unsigned batchSize = (TCacheSize + 1) / 2;
+
+    //! The pool from which the buffers are allocated.
+    TPool& m_pool;
+    //! The magazine of free buffers, which is only accessed by the owner.
+    buffer_type* m_cached[TCacheSize];
+    //! The number of buffers in the magazine.
+    unsigned m_numCached;
+    //! A stack of buffers which have been disposed.
+    std::atomic<BufferBase*> m_returned;
+    //! The number of buffers on the stack.
+    std::atomic<unsigned> m_numReturned;
+    //! Set while the owner is blocked on the pool.
+    std::atomic<bool> m_ownerWaiting;
+
+    //! Takes the ownership of a \p buffer from the pool.
+    buffer_type* adopt(buffer_type* buffer)
+    {
+        buffer->setDisposer(this);
+        return buffer;
+    }
+
+    //! Moves the returned buffers into the magazine.
+    void collectReturnedBuffers()
+    {
+        BufferBase* buffer = m_returned.exchange(0);
+        unsigned count = 0;
+        while (buffer)
+        {
+            BufferBase* next = buffer->nextSegment();
+            buffer->setNextSegment(0);
+            buffer->clear();
+            if (m_numCached < TCacheSize)
+                m_cached[m_numCached++] = static_cast<buffer_type*>(buffer);
+            else
+                m_pool.release(static_cast<buffer_type*>(buffer));
+            buffer = next;
+            ++count;
+        }
+        m_numReturned.fetch_sub(count, std::memory_order_relaxed);
+    }
+
+    //! Releases the returned buffers to the pool.
+    void releaseReturnedBuffers()
+    {
+        BufferBase* buffer = m_returned.exchange(0);
+        unsigned count = 0;
+        while (buffer)
+        {
+            BufferBase* next = buffer->nextSegment();
+            buffer->setNextSegment(0);
+            m_pool.release(static_cast<buffer_type*>(buffer));
+            buffer = next;
+            ++count;
+        }
+        m_numReturned.fetch_sub(count, std::memory_order_relaxed);
+    }
+
+    //! Refills the empty magazine.
+    void refill()
+    {
+        collectReturnedBuffers();
+        while (m_numCached < batchSize && !m_pool.empty())
+        {
+            buffer_type* buffer = m_pool.try_allocate();
+            if (!buffer)
+                break;
+            m_cached[m_numCached++] = adopt(buffer);
+        }
+    }
+};
+
+namespace detail
+{
+
+// The caches of the size classes of a SegregatedBufferCache. Every size
+// class holds a BufferCache in front of the corresponding BufferPool and
+// inherits the larger size classes.
+template <typename TFirst, typename TLast, unsigned TCacheSize>
+class BufferCacheClassChain
+        : public BufferCacheClassChain<typename boost::mpl::next<TFirst>::type,
+                                       TLast, TCacheSize>
+{
+    typedef BufferSizeClassChain<TFirst, TLast> classes_t;
+    typedef BufferCacheClassChain<typename boost::mpl::next<TFirst>::type,
+                                  TLast, TCacheSize> base_t;
+
+public:
+    explicit BufferCacheClassChain(classes_t& classes)
+        : base_t(classes),
+          m_classes(classes),
+          m_cache(classes.pool())
+    {
+    }
+
+    BufferBase* allocate(std::size_t sizeHint)
+    {
+        if (!m_classes.fits(sizeHint))
+            return base_t::allocate(sizeHint);
+
+        // Prefer a larger buffer over blocking the caller.
+        BufferBase* buffer = try_allocate(sizeHint);
+        return buffer ? buffer : m_cache.allocate();
+    }
+
+    BufferBase* try_allocate(std::size_t sizeHint)
+    {
+        if (m_classes.fits(sizeHint))
+        {
+            BufferBase* buffer = m_cache.try_allocate();
+            if (buffer)
+                return buffer;
+        }
+        return base_t::try_allocate(sizeHint);
+    }
+
+    unsigned size() const
+    {
+        return m_cache.size() + base_t::size();
+    }
+
+    void flush()
+    {
+        m_cache.flush();
+        base_t::flush();
+    }
+
+private:
+    const classes_t& m_classes;
+    BufferCache<typename classes_t::pool_t, TCacheSize> m_cache;
+};
+
+template <typename TLast, unsigned TCacheSize>
+class BufferCacheClassChain<TLast, TLast, TCacheSize>
+{
+public:
+    explicit BufferCacheClassChain(
+            BufferSizeClassChain<TLast, TLast>& /*classes*/)
+    {
+    }
+
+    BufferBase* allocate(std::size_t /*sizeHint*/)
+    {
+        UNET_ASSERT(false);
+        return 0;
+    }
+
+    BufferBase* try_allocate(std::size_t /*sizeHint*/)
+    {
+        return 0;
+    }
+
+    unsigned size() const
+    {
+        return 0;
+    }
+
+    void flush()
+    {
+    }
+};
+
+} // namespace detail
+
+//! A cache of free buffers in front of a SegregatedBufferPool.
+//! The SegregatedBufferCache holds a BufferCache of \p TCacheSize buffers
+//! for every size class of the pool \p TPool. Like a BufferCache, it is
+//! owned by a single thread and the buffers which it hands out may be
+//! disposed from any thread. The buffers are selected in the same way as
+//! by the pool: The smallest class which can hold the requested number of
+//! bytes is tried first, then the larger classes. Only if all of them are
+//! exhausted, a blocking allocation waits for the fitting class.
+//!
+//! Every cache keeps up to \p TCacheSize buffers of a class which it has
+//! handed out and another \p TCacheSize which have been returned to it.
+//! These buffers are not available to other threads. The capacity of a size
+//! class should be large enough for the caches of all threads.
+//!
+//! If \p TCacheSize is zero, nothing is cached and all allocations are
+//! passed on to the pool.
+//!
+//! The cache must outlive all buffers which have been allocated from it.
+template <typename TPool, unsigned TCacheSize>
+class SegregatedBufferCache : public BufferAllocator, boost::noncopyable
+{
+    typedef detail::BufferCacheClassChain<
+                typename boost::mpl::begin<
+                    typename TPool::class_list_t>::type,
+                typename boost::mpl::end<
+                    typename TPool::class_list_t>::type,
+                TCacheSize> chain_t;
+
+public:
+    //! Creates an empty cache in front of the \p pool.
+    explicit SegregatedBufferCache(TPool& pool)
+        : m_classes(pool.classes())
+    {
+    }
+
+    //! Destroys the cache and returns all cached buffers to the pool.
+    ~SegregatedBufferCache()
+    {
+        flush();
+    }
+
+    //! Allocates a buffer from the largest size class.
+    virtual BufferBase* allocate()
+    {
+        return m_classes.allocate(std::size_t(-1));
+    }
+
+    //! Allocates a buffer.
+    //! Allocates a buffer which can hold at least \p sizeHint bytes of data.
+    //! If the request exceeds the largest size class, a buffer of the largest
+    //! class is returned. The calling thread is blocked until a buffer is
+    //! available. This method must only be called by the owner of the cache.
+    BufferBase* allocate(std::size_t sizeHint)
+    {
+        return m_classes.allocate(sizeHint);
+    }
+
+    //! Flushes the cache.
+    //! Returns the buffers of all size classes to the pool. This method must
+    //! only be called by the owner of the cache.
+    void flush()
+    {
+        m_classes.flush();
+    }
+
+    //! Returns the number of buffers in the cache.
+    unsigned size() const
+    {
+        return m_classes.size();
+    }
+
+    //! Tries to allocate a buffer from the largest size class.
+    virtual BufferBase* try_allocate()
+    {
+        return m_classes.try_allocate(std::size_t(-1));
+    }
+
+    //! Tries to allocate a buffer.
+    //! Allocates a buffer which can hold at least \p sizeHint bytes of data.
+    //! If no such buffer is available, a null-pointer is returned. This
+    //! method must only be called by the owner of the cache.
+    BufferBase* try_allocate(std::size_t sizeHint)
+    {
+        return m_classes.try_allocate(sizeHint);
+    }
+
+private:
+    //! The caches of the size classes.
+    chain_t m_classes;
+};
+
+template <typename TPool>
+class SegregatedBufferCache<TPool, 0> : public BufferAllocator,
+                                        boost::noncopyable
+{
+public:
+    explicit SegregatedBufferCache(TPool& pool)
+        : m_pool(pool)
+    {
+    }
+
+    virtual BufferBase* allocate()
+    {
+        return m_pool.allocate();
+    }
+
+    BufferBase* allocate(std::size_t sizeHint)
+    {
+        return m_pool.allocate(sizeHint);
+    }
+
+    void flush()
+    {
+    }
+
+    unsigned size() const
+    {
+        return 0;
+    }
+
+    virtual BufferBase* try_allocate()
+    {
+        return m_pool.try_allocate();
+    }
+
+    BufferBase* try_allocate(std::size_t sizeHint)
+    {
+        return m_pool.try_allocate(sizeHint);
+    }
+
+private:
+    TPool& m_pool;
+};
+
+} // namespace uNet
+
+#endif // UNET_BUFFERCACHE_HPP
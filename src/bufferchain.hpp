@@ -0,0 +1,250 @@
+#ifndef UNET_BUFFERCHAIN_HPP
+#define UNET_BUFFERCHAIN_HPP
+
+#include "config.hpp"
+
+#include "buffer.hpp"
+
+#include <boost/utility.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+
+namespace uNet
+{
+
+//! A chain of buffers.
+//! A BufferChain holds a packet which is too large for a single buffer. The
+//! data is stored in a linked list of buffers (segments), which are
+//! allocated from a BufferAllocator on demand. The first segment keeps the
+//! reserved space in front of the data such that the headers can be
+//! prepended to it. All further segments use their whole storage for the
+//! data.
+//!
+//! The chain owns its segments until the packet is handed over with
+//! release(). Afterwards, disposing the first segment disposes the whole
+//! chain.
+class BufferChain : boost::noncopyable
+{
+public:
+    //! An iterator over the bytes of the chain.
+    class const_iterator
+        : public std::iterator<std::forward_iterator_tag, std::uint8_t>
+    {
+    public:
+        const_iterator()
+            : m_segment(0),
+              m_position(0)
+        {
+        }
+
+        const std::uint8_t& operator* () const
+        {
+            return *m_position;
+        }
+
+        const_iterator& operator++ ()
+        {
+            ++m_position;
+            skipEmptySegments();
+            return *this;
+        }
+
+        const_iterator operator++ (int)
+        {
+            const_iterator temp(*this);
+            ++*this;
+            return temp;
+        }
+
+        bool operator== (const const_iterator& other) const
+        {
+            return m_position == other.m_position;
+        }
+
+        bool operator!= (const const_iterator& other) const
+        {
+            return m_position != other.m_position;
+        }
+
+    private:
+        //! The current segment.
+        const BufferBase* m_segment;
+        //! The current position within the segment.
+        const std::uint8_t* m_position;
+
+        explicit const_iterator(const BufferBase* segment)
+            : m_segment(segment),
+              m_position(segment ? segment->begin() : 0)
+        {
+            skipEmptySegments();
+        }
+
+        //! Moves the iterator to the next segment, if it has reached the
+        //! end of the current one. Past the last segment, the position is
+        //! a null-pointer.
+        void skipEmptySegments()
+        {
+            while (m_segment && m_position == m_segment->end())
+            {
+                m_segment = m_segment->nextSegment();
+                m_position = m_segment ? m_segment->begin() : 0;
+            }
+        }
+
+        friend class BufferChain;
+    };
+
+    //! Creates a buffer chain.
+    //! Creates a chain whose segments are allocated from the \p allocator.
+    //! The first segment is allocated immediately.
+    explicit BufferChain(BufferAllocator& allocator)
+        : m_allocator(allocator),
+          m_head(allocator.allocate()),
+          m_tail(m_head)
+    {
+    }
+
+    //! Destroys the buffer chain.
+    //! Disposes all segments unless the chain has been released.
+    ~BufferChain()
+    {
+        if (m_head)
+            m_head->dispose();
+    }
+
+    //! Appends data.
+    //! Copies \p size bytes from \p data to the end of the chain. If the last
+    //! segment is full, new segments are allocated.
+    void append(const void* data, std::size_t size)
+    {
+        UNET_ASSERT(m_head);
+        const std::uint8_t* source = static_cast<const std::uint8_t*>(data);
+        while (size)
+        {
+            if (m_tail->back_capacity() == 0)
+                appendSegment();
+            std::size_t chunk = m_tail->back_capacity();
+            if (chunk > size)
+                chunk = size;
+            m_tail->append(source, chunk);
+            source += chunk;
+            size -= chunk;
+        }
+    }
+
+    //! Returns an iterator to the first byte of the chain.
+    const_iterator begin() const
+    {
+        return const_iterator(m_head);
+    }
+
+    //! Returns an iterator past the last byte of the chain.
+    const_iterator end() const
+    {
+        return const_iterator();
+    }
+
+    //! Returns the first segment.
+    BufferBase* head() const
+    {
+        return m_head;
+    }
+
+    //! Returns the number of segments.
+    std::size_t numSegments() const
+    {
+        std::size_t count = 0;
+        for (const BufferBase* segment = m_head; segment;
+             segment = segment->nextSegment())
+        {
+            ++count;
+        }
+        return count;
+    }
+
+    //! Removes data from the front.
+    //! Copies \p size bytes from the beginning of the chain to \p data and
+    //! removes them from the chain. Segments which become empty are
+    //! disposed except for the last one.
+    void extract_front(void* data, std::size_t size)
+    {
+        UNET_ASSERT(m_head && m_head->totalSize() >= size);
+        std::uint8_t* destination = static_cast<std::uint8_t*>(data);
+        while (size)
+        {
+            std::size_t chunk = m_head->size();
+            if (chunk > size)
+                chunk = size;
+            m_head->extract_front(destination, chunk);
+            destination += chunk;
+            size -= chunk;
+
+            if (m_head->size() == 0 && m_head != m_tail)
+            {
+                BufferBase* empty = m_head;
+                m_head = m_head->nextSegment();
+                empty->setNextSegment(0);
+                empty->dispose();
+            }
+        }
+    }
+
+    //! Pops an element from the beginning of the chain.
+    //! Pops an element of type \p TType from the beginning of the chain. The
+    //! element may span several segments.
+    template <typename TType>
+    TType pop_front()
+    {
+        TType temp;
+        extract_front(&temp, sizeof(TType));
+        return temp;
+    }
+
+    //! Adds an element at the end of the chain.
+    //! Copies the given \p data element at the end of the chain. The element
+    //! may span several segments.
+    template <typename TType>
+    void push_back(const TType& data)
+    {
+        append(&data, sizeof(TType));
+    }
+
+    //! Releases the chain.
+    //! Returns the first segment and gives up the ownership of the chain.
+    //! The segments are disposed when the first segment is disposed.
+    BufferBase* release()
+    {
+        BufferBase* head = m_head;
+        m_head = m_tail = 0;
+        return head;
+    }
+
+    //! Returns the number of bytes in the chain.
+    std::size_t size() const
+    {
+        return m_head ? m_head->totalSize() : 0;
+    }
+
+private:
+    //! The allocator for the segments.
+    BufferAllocator& m_allocator;
+    //! The first segment.
+    BufferBase* m_head;
+    //! The last segment.
+    BufferBase* m_tail;
+
+    //! Allocates a new segment and appends it to the chain.
+    void appendSegment()
+    {
+        BufferBase* segment = m_allocator.allocate();
+        segment->rewind();
+        m_tail->setNextSegment(segment);
+        m_tail = segment;
+    }
+};
+
+} // namespace uNet
+
+#endif // UNET_BUFFERCHAIN_HPP
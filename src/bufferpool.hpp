@@ -4,37 +4,81 @@
 #include "config.hpp"
 
 #include "buffer.hpp"
+#include "heapobjectpool.hpp"
 
 #include <OperatingSystem/OperatingSystem.h>
 
+#include <atomic>
+
 namespace uNet
 {
 
+//! Statistics of a buffer pool.
+struct BufferPoolStatistics
+{
+    BufferPoolStatistics()
+        : capacity(0),
+          numAllocated(0),
+          maxNumAllocated(0),
+          numAllocationFailures(0)
+    {
+    }
+
+    //! The total number of buffers in the pool.
+    unsigned capacity;
+    //! The number of buffers which are currently allocated.
+    unsigned numAllocated;
+    //! The maximum number of buffers which have been allocated at the same
+    //! time (the high-water mark).
+    unsigned maxNumAllocated;
+    //! The number of non-blocking allocations which have failed because the
+    //! pool was empty.
+    unsigned numAllocationFailures;
+};
+
 //! A pool for buffers.
 //! The BufferPool is an object pool for buffers. Both, the size of a buffer
 //! and the number of buffers in the pool, are template parameters and thus
 //! configurable at compile time. The parameter \p TBufferSize is the byte
 //! size of each buffer and \p TNumBuffers is the total number of buffers
-//! in the pool.
+//! in the pool. If \p TNumBuffers is zero, the pool is unlimited and grows
+//! on the heap in slabs of buffers (see HeapObjectPool).
 //!
 //! The BufferPool implements the BufferDisposer interface. Every buffer
 //! which is constructed via this pool holds a pointer back to the pool.
 //! This means that every buffer can return itself to the pool from which
-//! it was created.
+//! it was created. It also implements the BufferAllocator interface, which
+//! is used by a BufferChain to allocate further segments.
 template <unsigned TBufferSize, unsigned TNumBuffers>
-class BufferPool : public BufferDisposer
+class BufferPool : public BufferAllocator, public BufferDisposer
 {
+    typedef detail::object_pool_type_dispatcher<
+                Buffer<TBufferSize, 4>, TNumBuffers> pool_dispatcher_t;
+
 public:
     //! The type of the buffer in this pool.
     typedef Buffer<TBufferSize, 4> buffer_type;
 
+    //! Creates a buffer pool.
+    //! Creates a buffer pool whose buffers reserve \p headroom bytes in front
+    //! of the data.
+    explicit BufferPool(std::size_t headroom = BufferBase::defaultHeadroom)
+        : m_headroom(headroom),
+          m_numAllocated(0),
+          m_maxNumAllocated(0),
+          m_numAllocationFailures(0)
+    {
+    }
+
     //! Allocates a buffer from the pool.
     //! Allocates a buffer from the pool and returns a pointer to it. If the
     //! pool is empty, the calling thread is blocked until a buffer has been
     //! released.
-    buffer_type* allocate()
+    virtual buffer_type* allocate()
     {
-        return m_pool.construct(this);
+        buffer_type* buffer = m_pool.construct(this, m_headroom);
+        countAllocation();
+        return buffer;
     }
 
     //! Checks if the pool is empty.
@@ -44,20 +88,55 @@ public:
         return m_pool.empty();
     }
 
+    //! Returns the number of bytes which the buffers reserve in front of the
+    //! data.
+    std::size_t headroom() const
+    {
+        return m_headroom;
+    }
+
     //! Releases a buffer.
     //! Releases the \p buffer which must have been acquired from this pool.
     void release(buffer_type* const buffer)
     {
+        m_numAllocated.fetch_sub(1, std::memory_order_relaxed);
         m_pool.destroy(buffer);
     }
 
+    //! Returns the statistics of the pool.
+    BufferPoolStatistics statistics() const
+    {
+        BufferPoolStatistics stats;
+        stats.capacity = pool_dispatcher_t::capacity(m_pool);
+        stats.numAllocated = m_numAllocated.load(std::memory_order_relaxed);
+        stats.maxNumAllocated
+                = m_maxNumAllocated.load(std::memory_order_relaxed);
+        stats.numAllocationFailures
+                = m_numAllocationFailures.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+    //! Releases unused memory.
+    //! Returns unused memory of an unlimited pool to the heap until at most
+    //! \p maxNumFree buffers are free. A pool with a fixed number of buffers
+    //! is not changed.
+    void trim(std::size_t maxNumFree = 0)
+    {
+        pool_dispatcher_t::trim(m_pool, maxNumFree);
+    }
+
     //! Tries to allocate a buffer.
     //! If a buffer is available in the pool, it is allocated and a pointer
     //! to it is returned. If no buffer is available, a null-pointer is
     //! returned instead. The calling thread won't be blocked.
-    buffer_type* try_allocate()
+    virtual buffer_type* try_allocate()
     {
-        return m_pool.try_construct(this);
+        buffer_type* buffer = m_pool.try_construct(this, m_headroom);
+        if (buffer)
+            countAllocation();
+        else
+            m_numAllocationFailures.fetch_add(1, std::memory_order_relaxed);
+        return buffer;
     }
 
 protected:
@@ -68,7 +147,86 @@ protected:
     }
 
 private:
-    OperatingSystem::counting_object_pool<buffer_type, TNumBuffers> m_pool;
+    typename pool_dispatcher_t::type m_pool;
+    //! The headroom of the buffers.
+    std::size_t m_headroom;
+    //! The number of allocated buffers.
+    std::atomic<unsigned> m_numAllocated;
+    //! The high-water mark of allocated buffers.
+    std::atomic<unsigned> m_maxNumAllocated;
+    //! The number of failed allocations.
+    std::atomic<unsigned> m_numAllocationFailures;
+
+    //! Updates the statistics after a buffer has been allocated.
+    void countAllocation()
+    {
+        unsigned numAllocated
+                = m_numAllocated.fetch_add(1, std::memory_order_relaxed) + 1;
+        unsigned maxNumAllocated
+                = m_maxNumAllocated.load(std::memory_order_relaxed);
+        while (numAllocated > maxNumAllocated
+               && !m_maxNumAllocated.compare_exchange_weak(
+                       maxNumAllocated, numAllocated,
+                       std::memory_order_relaxed))
+        {
+        }
+    }
+};
+
+//! A pool for buffer mementos.
+//! The BufferMementoPool holds \p TNumMementos mementos or is unlimited, if
+//! \p TNumMementos is zero. A memento which is
+//! allocated from the pool is returned to it automatically when the buffer
+//! to which it has been added is disposed, i.e. after the buffer has been
+//! handed to the memento's grabber.
+//!
+//! A reliable protocol uses the pool as follows: Before it sends a packet,
+//! it allocates a memento and adds it to the packet. When the interface
+//! has sent the packet and disposes it, the protocol gets the buffer back
+//! with the iterators restored and can keep it for a retransmission.
+template <unsigned TNumMementos>
+class BufferMementoPool : public BufferMementoDisposer
+{
+public:
+    //! Allocates a memento.
+    //! Allocates a memento which returns the buffer to the \p grabber. If
+    //! the pool is empty, the calling thread is blocked until a memento has
+    //! been released.
+    BufferMemento* allocate(BufferGrabber* grabber)
+    {
+        return m_pool.construct(grabber, this);
+    }
+
+    //! Checks if the pool is empty.
+    bool empty() const
+    {
+        return m_pool.empty();
+    }
+
+    //! Releases the \p memento which must have been acquired from this pool.
+    void release(BufferMemento* memento)
+    {
+        m_pool.destroy(memento);
+    }
+
+    //! Tries to allocate a memento.
+    //! Allocates a memento which returns the buffer to the \p grabber. If
+    //! the pool is empty, a null-pointer is returned.
+    BufferMemento* try_allocate(BufferGrabber* grabber)
+    {
+        return m_pool.try_construct(grabber, this);
+    }
+
+protected:
+    //! \reimp
+    virtual void dispose(BufferMemento* memento)
+    {
+        release(memento);
+    }
+
+private:
+    typename detail::object_pool_type_dispatcher<
+                 BufferMemento, TNumMementos>::type m_pool;
 };
 
 } // namespace uNet
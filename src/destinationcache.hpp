@@ -0,0 +1,123 @@
+#ifndef UNET_DESTINATIONCACHE_HPP
+#define UNET_DESTINATIONCACHE_HPP
+
+#include "config.hpp"
+
+#include "neighbor.hpp"
+#include "networkaddress.hpp"
+
+#include <boost/static_assert.hpp>
+
+#include <atomic>
+#include <cstdint>
+
+namespace uNet
+{
+
+//! The destination cache.
+//! The DestinationCache maps the final destination of a packet to the
+//! neighbor to which the packet has to be sent next. It caches the result
+//! of a routing table look-up followed by a neighbor cache look-up.
+//!
+//! The cache is direct-mapped, i.e. every destination address is hashed to
+//! exactly one entry and a new destination simply replaces the previous
+//! one. The number of entries \p TNumEntries must be a power of two.
+//!
+//! Every entry is tagged with the generation of the cache in which it has
+//! been created. invalidate() starts a new generation and thereby drops all
+//! entries in constant time. The cache has to be invalidated whenever a route
+//! changes or a neighbor is removed.
+template <unsigned TNumEntries>
+class DestinationCache
+{
+    BOOST_STATIC_ASSERT(TNumEntries > 0);
+    BOOST_STATIC_ASSERT((TNumEntries & (TNumEntries - 1)) == 0);
+
+public:
+    //! Creates an empty destination cache.
+    DestinationCache()
+        : m_generation(1)
+    {
+        for (unsigned idx = 0; idx < TNumEntries; ++idx)
+        {
+            m_entries[idx].m_neighbor = 0;
+            m_entries[idx].m_generation = 0;
+        }
+    }
+
+    //! Caches a destination.
+    //! Stores the \p neighbor via which the \p destination is reached. The
+    //! \p generation must have been read via generation() before the
+    //! neighbor has been looked up. If the cache has been invalidated in the
+    //! meantime, the neighbor is not cached such that it does not replace a
+    //! valid entry.
+    void cache(HostAddress destination, Neighbor* neighbor,
+               std::uint32_t generation)
+    {
+        if (generation != m_generation.load(std::memory_order_acquire))
+            return;
+
+        Entry& entry = m_entries[hash(destination)];
+        entry.m_destination = destination;
+        entry.m_neighbor = neighbor;
+        entry.m_generation = generation;
+    }
+
+    //! Returns the current generation.
+    std::uint32_t generation() const
+    {
+        return m_generation.load(std::memory_order_acquire);
+    }
+
+    //! Invalidates all entries.
+    //! Drops all cached destinations. This method may be called from any
+    //! thread.
+    void invalidate()
+    {
+        m_generation.fetch_add(1, std::memory_order_acq_rel);
+    }
+
+    //! Looks up a destination.
+    //! Returns the neighbor via which the \p destination is reached. If the
+    //! destination is not in the cache, a null-pointer is returned.
+    Neighbor* lookup(HostAddress destination) const
+    {
+        const Entry& entry = m_entries[hash(destination)];
+        if (   entry.m_generation
+                   == m_generation.load(std::memory_order_acquire)
+            && entry.m_destination == destination)
+        {
+            return entry.m_neighbor;
+        }
+        return 0;
+    }
+
+private:
+    struct Entry
+    {
+        //! The final destination.
+        HostAddress m_destination;
+        //! The neighbor to which packets for the destination are sent.
+        Neighbor* m_neighbor;
+        //! The generation in which the entry has been cached.
+        std::uint32_t m_generation;
+    };
+
+    //! The current generation. Entries with a different generation are
+    //! invalid.
+    std::atomic<std::uint32_t> m_generation;
+    //! The entries.
+    Entry m_entries[TNumEntries];
+
+    //! Maps a destination to the index of its entry.
+    static unsigned hash(HostAddress destination)
+    {
+        // Fibonacci hashing spreads consecutive addresses over the entries.
+        return ((std::uint32_t(destination.address()) * 2654435769u) >> 16)
+               & (TNumEntries - 1);
+    }
+};
+
+} // namespace uNet
+
+#endif // UNET_DESTINATIONCACHE_HPP
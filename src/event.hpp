@@ -3,6 +3,7 @@
 
 #include "config.hpp"
 
+#include "heapobjectpool.hpp"
 #include "networkaddress.hpp"
 
 #include <OperatingSystem/OperatingSystem.h>
@@ -12,6 +13,16 @@ namespace uNet
 class BufferBase;
 class NetworkInterface;
 
+template <unsigned>
+class EventList;
+template <unsigned>
+class LockFreeEventList;
+
+namespace detail
+{
+class RouteChangeRequest;
+} // namespace detail
+
 //! A kernel event.
 //! The Event is a happening in time inside the kernel or its associated
 //! components. The kernel keeps a list of events which have to be processed.
@@ -28,6 +39,7 @@ public:
         MessageSend,
 
         SendLinkLocalBroadcast,
+        RouteChange,
 
         StopKernel
     };
@@ -44,6 +56,7 @@ public:
     {
         m_interface = other.m_interface;
         m_buffer = other.m_buffer;
+        m_routeChange = other.m_routeChange;
     }
 
     Event& operator= (const Event& other)
@@ -52,6 +65,7 @@ public:
         m_type = other.m_type;
         m_interface = other.m_interface;
         m_buffer = other.m_buffer;
+        m_routeChange = other.m_routeChange;
         return *this;
     }
 
@@ -70,6 +84,20 @@ public:
         return m_buffer;
     }
 
+    detail::RouteChangeRequest* routeChange() const
+    {
+        return m_routeChange;
+    }
+
+    //! Returns the next event.
+    //! Returns the event which follows this one in a chain of events which
+    //! has been retrieved from an event list via retrieve_all(). A
+    //! null-pointer is returned for the last event in the chain.
+    Event* next() const
+    {
+        return m_next;
+    }
+
     //! Creates a message receive event.
     //! Creates an event to signal the reception of a \p buffer.
     static Event createMessageReceiveEvent(NetworkInterface* ifc,
@@ -99,6 +127,16 @@ public:
         return ev;
     }
 
+    //! Creates a route change event.
+    //! Creates an event which hands a route \p change over to the kernel's
+    //! event loop.
+    static Event createRouteChangeEvent(detail::RouteChangeRequest* change)
+    {
+        Event ev(RouteChange);
+        ev.m_routeChange = change;
+        return ev;
+    }
+
     //! \todo Remove this method again and allow the kernel to create events
     //! with arbitrary type.
     static Event createStopKernelEvent()
@@ -114,6 +152,7 @@ private:
     {
         m_interface = 0;
         m_buffer = 0;
+        m_routeChange = 0;
     }
 
     Type m_type;
@@ -121,20 +160,27 @@ private:
 
     NetworkInterface* m_interface;
     BufferBase* m_buffer;
+    detail::RouteChangeRequest* m_routeChange;
 
     template <unsigned>
     friend class EventList;
+    template <unsigned>
+    friend class LockFreeEventList;
 };
 
 //! An event list.
-//! The EventList is a list of events.
+//! The EventList is a list of events. Accesses to the list are synchronized
+//! with a mutex. The list holds up to \p MaxNumEventsT events. If this
+//! parameter is zero, the events are allocated from a HeapObjectPool and the
+//! list is unlimited.
 template <unsigned MaxNumEventsT>
 class EventList
 {
 public:
     EventList()
         : m_eventList(0),
-          m_numEvents(0)
+          m_lastEvent(0),
+          m_nonEmpty(0)
     {
     }
 
@@ -155,15 +201,13 @@ public:
 
         OperatingSystem::lock_guard<OperatingSystem::mutex> locker(m_mutex);
         if (!m_eventList)
-            m_eventList = event;
-        else
         {
-            Event* iter = m_eventList;
-            while (iter->m_next)
-                iter = iter->m_next;
-            iter->m_next = event;
+            m_eventList = event;
+            m_nonEmpty.post();
         }
-        m_numEvents.post();
+        else
+            m_lastEvent->m_next = event;
+        m_lastEvent = event;
     }
 
     //! Adds the copy of an event.
@@ -179,10 +223,14 @@ public:
 
     Event retrieve()
     {
-        m_numEvents.wait();
+        m_nonEmpty.wait();
         OperatingSystem::lock_guard<OperatingSystem::mutex> locker(m_mutex);
         Event* first = m_eventList;
         m_eventList = first->m_next;
+        if (m_eventList)
+            m_nonEmpty.post();
+        else
+            m_lastEvent = 0;
         first->m_next = 0;
 
         Event temp = *first;
@@ -190,15 +238,50 @@ public:
         return temp;
     }
 
+    //! Retrieves all events.
+    //! Detaches all events from the list and returns a pointer to the oldest
+    //! one. The remaining events can be reached via Event::next(). If the
+    //! list is empty, the calling thread is blocked until an event is
+    //! enqueued. Every event has to be returned with destroy() after it
+    //! has been processed.
+    Event* retrieve_all()
+    {
+        m_nonEmpty.wait();
+        OperatingSystem::lock_guard<OperatingSystem::mutex> locker(m_mutex);
+        Event* first = m_eventList;
+        m_eventList = m_lastEvent = 0;
+        return first;
+    }
+
+    //! Retrieves all events with a timeout.
+    //! Behaves like retrieve_all() but blocks the calling thread at most for
+    //! the given \p duration. Returns a null-pointer, if no event has been
+    //! enqueued in this time.
+    template <typename RepT, typename PeriodT>
+    Event* try_retrieve_all_for(
+            const OperatingSystem::chrono::duration<RepT, PeriodT>& duration)
+    {
+        if (!m_nonEmpty.try_wait_for(duration))
+            return 0;
+        OperatingSystem::lock_guard<OperatingSystem::mutex> locker(m_mutex);
+        Event* first = m_eventList;
+        m_eventList = m_lastEvent = 0;
+        return first;
+    }
+
 private:
     //! A mutex to synchronize accesses to the object.
     OperatingSystem::mutex m_mutex;
-    //! \todo Change this to a list sorted by timeout.
+    //! The first event in the list.
     Event* m_eventList;
+    //! The last event in the list.
+    Event* m_lastEvent;
     //! A pool for allocating events.
-    OperatingSystem::counting_object_pool<Event, MaxNumEventsT> m_eventPool;
-    //! The number of events which have been enqueued in the list.
-    OperatingSystem::semaphore m_numEvents;
+    typename detail::object_pool_type_dispatcher<
+                 Event, MaxNumEventsT>::type m_eventPool;
+    //! Signals that the list is not empty. The semaphore is posted when
+    //! an event is added to an empty list.
+    OperatingSystem::semaphore m_nonEmpty;
 };
 
 } // namespace uNet
@@ -0,0 +1,167 @@
+#ifndef UNET_FORWARDINGTABLE_HPP
+#define UNET_FORWARDINGTABLE_HPP
+
+#include "config.hpp"
+
+#include "networkaddress.hpp"
+#include "routingtable.hpp"
+
+#include <boost/static_assert.hpp>
+
+#include <cstdint>
+
+namespace uNet
+{
+
+//! A compiled forwarding table.
+//! The ForwardingTable is a drop-in replacement for the RoutingTable which
+//! trades memory for a constant look-up time. The routes are kept in a
+//! RoutingTable with \p TMaxNumRoutes entries. Whenever a route is added or
+//! removed, the table is compiled into a two-level array which is indexed
+//! directly with the 16-bit destination address.
+//!
+//! The first level has one entry for every value of the address' high
+//! byte. If all 256 addresses of such a block use the same route, the entry
+//! holds the route directly. Otherwise, it refers to a chunk of 256 route
+//! indices, which is indexed with the address' low byte. Thus, a look-up
+//! needs at most two loads plus the access to the route.
+//!
+//! The number of chunks is limited by \p TMaxNumChunks. A table with 256
+//! chunks is a fully direct-indexed table. If the chunks run out, the
+//! affected blocks are resolved via the RoutingTable.
+//!
+//! The table is compiled in place. Like the RoutingTable, it must not be
+//! modified while another thread resolves an address. The kernel applies
+//! route changes in its event loop for this reason.
+template <unsigned TMaxNumRoutes, unsigned TMaxNumChunks>
+class ForwardingTable
+{
+    BOOST_STATIC_ASSERT(TMaxNumChunks > 0 && TMaxNumChunks <= 256);
+    // The route indices have to fit into a byte.
+    BOOST_STATIC_ASSERT(TMaxNumRoutes < 256);
+
+public:
+    ForwardingTable()
+        : m_numChunks(0)
+    {
+        for (unsigned idx = 0; idx < 256; ++idx)
+            m_blocks[idx] = 0;
+    }
+
+    //! Adds a static route.
+    //! Adds a static entry to the routing table which routes packets for
+    //! the \p targetNetwork via the \p nextNeighbor. If there is already a
+    //! route for the \p targetNetwork, its next neighbor is replaced. The
+    //! forwarding table is compiled anew.
+    void addStaticRoute(NetworkAddress targetNetwork,
+                        HostAddress nextNeighbor)
+    {
+        m_routes.addStaticRoute(targetNetwork, nextNeighbor);
+        compile();
+    }
+
+    //! Tries to add a static route.
+    //! Adds a static route like addStaticRoute(). If the table is full,
+    //! \p false is returned instead of throwing an exception.
+    bool tryAddStaticRoute(NetworkAddress targetNetwork,
+                           HostAddress nextNeighbor)
+    {
+        if (!m_routes.tryAddStaticRoute(targetNetwork, nextNeighbor))
+            return false;
+        compile();
+        return true;
+    }
+
+    //! Removes a static route.
+    //! Removes the route for the \p targetNetwork. Returns \p true, if such
+    //! a route existed. The forwarding table is compiled anew.
+    bool removeStaticRoute(NetworkAddress targetNetwork)
+    {
+        if (!m_routes.removeStaticRoute(targetNetwork))
+            return false;
+        compile();
+        return true;
+    }
+
+    //! Resolves an address.
+    //! Looks up the \p destination address in the forwarding table and
+    //! returns the host address of the next neighbor, which is the next
+    //! target for the message.
+    HostAddress resolve(HostAddress destination) const
+    {
+        std::uint16_t block = m_blocks[destination.address() >> 8];
+        std::uint8_t route;
+        if (block < chunkFlag)
+            route = block;
+        else if (block != slowPath)
+            route = m_chunks[block - chunkFlag][destination.address() & 0xFF];
+        else
+            return m_routes.resolve(destination);
+
+        return route ? m_routes.route(route - 1).m_nextNeighbor
+                     : destination;
+    }
+
+private:
+    //! Entries of the first level which are greater or equal to this value
+    //! refer to a chunk.
+    static const std::uint16_t chunkFlag = 0x100;
+    //! Marks a block which has to be resolved via the routing table.
+    static const std::uint16_t slowPath = 0xFFFF;
+
+    //! The routes from which the table is compiled.
+    RoutingTable<TMaxNumRoutes> m_routes;
+    //! The first level of the table. An entry is either a route (the index
+    //! plus one or zero, if there is no route), chunkFlag plus the index of a
+    //! chunk or slowPath.
+    std::uint16_t m_blocks[256];
+    //! The second level of the table. Every element is the index of a route
+    //! plus one or zero, if no route matches.
+    std::uint8_t m_chunks[TMaxNumChunks][256];
+    //! The number of chunks in use.
+    unsigned m_numChunks;
+
+    //! Returns the compiled route for an address.
+    std::uint8_t compiledRoute(std::uint16_t address) const
+    {
+        std::size_t route = m_routes.findRoute(address);
+        return route < m_routes.numRoutes() ? route + 1 : 0;
+    }
+
+    //! Compiles the routing table into the forwarding table.
+    void compile()
+    {
+        m_numChunks = 0;
+        for (unsigned high = 0; high < 256; ++high)
+        {
+            std::uint16_t base = high << 8;
+            std::uint8_t first = compiledRoute(base);
+            unsigned low = 1;
+            while (low < 256 && compiledRoute(base | low) == first)
+                ++low;
+
+            if (low == 256)
+            {
+                m_blocks[high] = first;
+            }
+            else if (m_numChunks < TMaxNumChunks)
+            {
+                std::uint8_t* chunk = m_chunks[m_numChunks];
+                for (unsigned idx = 0; idx < low; ++idx)
+                    chunk[idx] = first;
+                for (; low < 256; ++low)
+                    chunk[low] = compiledRoute(base | low);
+                m_blocks[high] = chunkFlag + m_numChunks;
+                ++m_numChunks;
+            }
+            else
+            {
+                m_blocks[high] = slowPath;
+            }
+        }
+    }
+};
+
+} // namespace uNet
+
+#endif // UNET_FORWARDINGTABLE_HPP
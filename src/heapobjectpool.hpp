@@ -0,0 +1,288 @@
+#ifndef UNET_HEAPOBJECTPOOL_HPP
+#define UNET_HEAPOBJECTPOOL_HPP
+
+#include "config.hpp"
+
+#include <OperatingSystem/OperatingSystem.h>
+
+#include <boost/static_assert.hpp>
+#include <boost/type_traits/aligned_storage.hpp>
+#include <boost/type_traits/alignment_of.hpp>
+#include <boost/utility.hpp>
+
+#include <cstddef>
+#include <new>
+#include <utility>
+
+namespace uNet
+{
+
+//! A growable object pool.
+//! The HeapObjectPool is an object pool without a fixed capacity. It is a
+//! drop-in replacement for the counting_object_pool on hosts which have a
+//! heap. The memory is allocated in slabs of \p TSlabSize objects. When the
+//! pool runs out of free objects, another slab is allocated. Thus, the
+//! allocation of an object needs amortized constant time and an allocation
+//! never blocks the calling thread.
+//!
+//! The slabs are kept after the burst which has required them. They are
+//! only returned to the heap by trim().
+template <typename TType, unsigned TSlabSize = 16>
+class HeapObjectPool : boost::noncopyable
+{
+    BOOST_STATIC_ASSERT(TSlabSize > 0);
+
+public:
+    HeapObjectPool()
+        : m_slabs(0),
+          m_freeList(0),
+          m_numSlots(0),
+          m_numFree(0)
+    {
+    }
+
+    ~HeapObjectPool()
+    {
+        while (m_slabs)
+        {
+            Slab* slab = m_slabs;
+            m_slabs = slab->m_next;
+            delete slab;
+        }
+    }
+
+    //! Returns the number of objects for which memory has been allocated.
+    std::size_t capacity() const
+    {
+        OperatingSystem::lock_guard<OperatingSystem::mutex> locker(m_mutex);
+        return m_numSlots;
+    }
+
+    //! Creates an object.
+    //! Creates an object from the arguments \p args. If no memory can be
+    //! allocated, an exception is thrown.
+    template <typename... TArgs>
+    TType* construct(TArgs&&... args)
+    {
+        void* slot = allocate();
+        if (!slot)
+            ::uNet::throw_exception(-1); //! \todo system_error
+        return new (slot) TType(std::forward<TArgs>(args)...);
+    }
+
+    //! Destroys the object \p element, which must have been created by this
+    //! pool.
+    void destroy(TType* element)
+    {
+        element->~TType();
+        free(element);
+    }
+
+    //! Checks if the pool is empty. As the pool grows on demand, this is
+    //! never the case.
+    bool empty() const
+    {
+        return false;
+    }
+
+    //! Returns the number of slabs.
+    std::size_t numSlabs() const
+    {
+        OperatingSystem::lock_guard<OperatingSystem::mutex> locker(m_mutex);
+        return m_numSlots / TSlabSize;
+    }
+
+    //! Releases unused memory.
+    //! Returns slabs without any object to the heap until at most
+    //! \p maxNumFree objects are free.
+    void trim(std::size_t maxNumFree = 0)
+    {
+        OperatingSystem::lock_guard<OperatingSystem::mutex> locker(m_mutex);
+        if (m_numFree <= maxNumFree)
+            return;
+
+        // Select the empty slabs which will be released.
+        std::size_t numFree = m_numFree;
+        for (Slab* slab = m_slabs; slab; slab = slab->m_next)
+        {
+            slab->m_release = slab->m_numUsed == 0
+                              && numFree >= maxNumFree + TSlabSize;
+            if (slab->m_release)
+                numFree -= TSlabSize;
+        }
+        if (numFree == m_numFree)
+            return;
+
+        // Unlink their slots from the free list.
+        Slot** link = &m_freeList;
+        while (*link)
+        {
+            if ((*link)->m_slab->m_release)
+                *link = (*link)->m_next;
+            else
+                link = &(*link)->m_next;
+        }
+
+        Slab** slabLink = &m_slabs;
+        while (*slabLink)
+        {
+            Slab* slab = *slabLink;
+            if (slab->m_release)
+            {
+                *slabLink = slab->m_next;
+                delete slab;
+            }
+            else
+                slabLink = &slab->m_next;
+        }
+
+        m_numSlots -= m_numFree - numFree;
+        m_numFree = numFree;
+    }
+
+    //! Tries to create an object.
+    //! Creates an object from the arguments \p args. If no memory can be
+    //! allocated, a null-pointer is returned.
+    template <typename... TArgs>
+    TType* try_construct(TArgs&&... args)
+    {
+        void* slot = allocate();
+        return slot ? new (slot) TType(std::forward<TArgs>(args)...) : 0;
+    }
+
+private:
+    struct Slab;
+
+    //! The memory for one object. The storage comes first such that an
+    //! object can be converted back into its slot.
+    struct Slot
+    {
+        typename boost::aligned_storage<
+                sizeof(TType),
+                boost::alignment_of<TType>::value>::type m_storage;
+        //! The next free slot.
+        Slot* m_next;
+        //! The slab which contains the slot.
+        Slab* m_slab;
+    };
+
+    struct Slab
+    {
+        Slot m_slots[TSlabSize];
+        //! The next slab.
+        Slab* m_next;
+        //! The number of slots which hold an object.
+        unsigned m_numUsed;
+        //! Set by trim() if the slab is going to be released.
+        bool m_release;
+    };
+
+    //! A mutex to synchronize accesses to the pool.
+    mutable OperatingSystem::mutex m_mutex;
+    //! The list of slabs.
+    Slab* m_slabs;
+    //! The list of free slots.
+    Slot* m_freeList;
+    //! The total number of slots.
+    std::size_t m_numSlots;
+    //! The number of free slots.
+    std::size_t m_numFree;
+
+    //! Allocates a slot. Returns a null-pointer if the heap is exhausted.
+    void* allocate()
+    {
+        OperatingSystem::lock_guard<OperatingSystem::mutex> locker(m_mutex);
+        if (!m_freeList && !grow())
+            return 0;
+
+        Slot* slot = m_freeList;
+        m_freeList = slot->m_next;
+        ++slot->m_slab->m_numUsed;
+        --m_numFree;
+        return &slot->m_storage;
+    }
+
+    //! Returns the slot of \p element to the free list.
+    void free(void* element)
+    {
+        Slot* slot = static_cast<Slot*>(element);
+        OperatingSystem::lock_guard<OperatingSystem::mutex> locker(m_mutex);
+        --slot->m_slab->m_numUsed;
+        slot->m_next = m_freeList;
+        m_freeList = slot;
+        ++m_numFree;
+    }
+
+    //! Allocates another slab and adds its slots to the free list.
+    bool grow()
+    {
+        Slab* slab = new (std::nothrow) Slab;
+        if (!slab)
+            return false;
+
+        slab->m_next = m_slabs;
+        slab->m_numUsed = 0;
+        slab->m_release = false;
+        m_slabs = slab;
+        for (unsigned idx = 0; idx < TSlabSize; ++idx)
+        {
+            slab->m_slots[idx].m_slab = slab;
+            slab->m_slots[idx].m_next = m_freeList;
+            m_freeList = &slab->m_slots[idx];
+        }
+        m_numSlots += TSlabSize;
+        m_numFree += TSlabSize;
+        return true;
+    }
+};
+
+namespace detail
+{
+
+template <typename TType, unsigned TCapacity, bool TGreaterZero>
+struct object_pool_type_dispatch_helper;
+
+template <typename TType, unsigned TCapacity>
+struct object_pool_type_dispatch_helper<TType, TCapacity, true>
+{
+    typedef OperatingSystem::counting_object_pool<TType, TCapacity> type;
+
+    static std::size_t capacity(const type& /*pool*/)
+    {
+        return TCapacity;
+    }
+
+    static void trim(type& /*pool*/, std::size_t /*maxNumFree*/)
+    {
+    }
+};
+
+template <typename TType, unsigned TCapacity>
+struct object_pool_type_dispatch_helper<TType, TCapacity, false>
+{
+    typedef HeapObjectPool<TType> type;
+
+    static std::size_t capacity(const type& pool)
+    {
+        return pool.capacity();
+    }
+
+    static void trim(type& pool, std::size_t maxNumFree)
+    {
+        pool.trim(maxNumFree);
+    }
+};
+
+// A helper struct to dispatch the type of an object pool. A capacity of
+// zero selects a pool which grows on the heap.
+template <typename TType, unsigned TCapacity>
+struct object_pool_type_dispatcher
+        : object_pool_type_dispatch_helper<TType, TCapacity, (TCapacity > 0)>
+{
+};
+
+} // namespace detail
+
+} // namespace uNet
+
+#endif // UNET_HEAPOBJECTPOOL_HPP
@@ -3,17 +3,30 @@
 
 #include "config.hpp"
 
+#include "buffercache.hpp"
+#include "bufferchain.hpp"
 #include "bufferpool.hpp"
+#include "destinationcache.hpp"
 #include "event.hpp"
+#include "forwardingtable.hpp"
 #include "kernelbase.hpp"
+#include "lockfreeeventlist.hpp"
 #include "networkcontrolprotocol.hpp"
 #include "networkprotocol.hpp"
 #include "networkinterface.hpp"
 #include "routingtable.hpp"
+#include "segregatedbufferpool.hpp"
+#include "timerwheel.hpp"
 #include "protocol/protocolhandlerchain.hpp"
 
 #include <OperatingSystem/OperatingSystem.h>
 
+#include <boost/mpl/empty.hpp>
+#include <boost/mpl/eval_if.hpp>
+#include <boost/mpl/identity.hpp>
+#include <boost/static_assert.hpp>
+
+#include <atomic>
 #include <cstddef>
 
 #include "neighborcache.hpp"
@@ -31,10 +44,37 @@ struct default_kernel_traits
     //! of buffers is unlimited and only restricted by the available memory.
     static const unsigned max_num_buffers = 10;
 
+    //! The size classes of the buffer pool. This is an MPL sequence of
+    //! buffer_class<size, number> types sorted by the size in ascending order,
+    //! e.g. boost::mpl::vector<buffer_class<64, 16>, buffer_class<256, 8> >.
+    //! A buffer is allocated from the smallest class which fits the requested
+    //! size. If the list is empty, the pool consists of a single class with
+    //! max_num_buffers buffers of buffer_size bytes.
+    typedef boost::mpl::vector<> buffer_class_list_t;
+
+    //! The number of free buffers per size class which a buffer cache keeps
+    //! for its thread (see Kernel::buffer_cache_t). The buffers in the caches
+    //! are not available to other threads. If this value is set to zero,
+    //! the caches pass all allocations on to the buffer pool.
+    static const unsigned buffer_cache_size = 0;
+
+    //! The size of one control buffer in bytes. Control buffers are used
+    //! for the kernel's own network control messages.
+    static const unsigned control_buffer_size = 64;
+
+    //! The number of control buffers. These buffers are reserved for
+    //! network control messages such as neighbor solicitations, which can
+    //! therefore be sent even if the user has allocated all other buffers.
+    static const unsigned max_num_control_buffers = 2;
+
     //! The maximum length of the kernel's event list. If this value is set
     //! to zero, no limit is imposed on the number of events.
     static const unsigned max_num_events = 20;
 
+    //! If set, the kernel's event list is a lock-free queue. Otherwise,
+    //! the accesses to the event list are synchronized with a mutex.
+    static const bool lock_free_event_list = true;
+
     //! The maximum number of interfaces which can be added to the kernel.
     static const unsigned max_num_interfaces = 5;
 
@@ -45,8 +85,51 @@ struct default_kernel_traits
     //! create latency and traffic on the bus.
     static const unsigned max_num_cached_neighbors = 5;
 
+    //! The number of entries in the destination cache, which maps the final
+    //! destination of a packet to the next neighbor. This value must be a
+    //! power of two.
+    static const unsigned max_num_cached_destinations = 8;
+
+    //! The maximum number of routes in the routing table.
+    static const unsigned max_num_routes = 10;
+
+    //! The number of 256-byte chunks of the compiled forwarding table. If
+    //! this value is greater than zero, the routing table is compiled into
+    //! a directly indexed table whenever a route is added. A value of 256
+    //! creates a table with one entry for every possible destination. If
+    //! the value is set to zero, the routes are resolved with a linear
+    //! search, which needs considerably less memory.
+    static const unsigned max_num_forwarding_table_chunks = 0;
+
+    //! The maximum number of neighbor solicitations which are sent to
+    //! resolve or probe a neighbor. If the neighbor does not answer, its
+    //! entry is removed from the neighbor cache and all packets which have
+    //! been queued for it are dropped.
+    static const unsigned max_num_neighbor_solicitations = 3;
+
+    //! The time in milliseconds between two neighbor solicitations.
+    static const unsigned neighbor_retransmit_time_ms = 1000;
+
+    //! The time in milliseconds for which a neighbor is considered to be
+    //! reachable after its reachability has been confirmed.
+    static const unsigned neighbor_reachable_time_ms = 30000;
+
+    //! The time in milliseconds which the kernel waits for a confirmation
+    //! from an upper layer before it probes a stale neighbor.
+    static const unsigned neighbor_delay_time_ms = 5000;
+
+    //! The duration of one tick of the kernel's timers in milliseconds. All
+    //! timeouts are rounded up to a multiple of this value.
+    static const unsigned timer_tick_ms = 10;
+
     //! A list of protocols which are attached to the kernel.
     typedef boost::mpl::vector<> protocol_list_t;
+
+    //! The size of the largest header which is prepended by a protocol that
+    //! is not in the protocol_list_t, e.g. by a custom protocol handler. The
+    //! headroom of the buffers is large enough for this header and for the
+    //! headers of all protocols in the protocol_list_t.
+    static const unsigned custom_header_size = 0;
 };
 
 namespace detail
@@ -54,35 +137,119 @@ namespace detail
 template <unsigned TBufferSize, unsigned TMaxNumBuffers, bool TGreaterZero>
 struct buffer_pool_type_dispatch_helper;
 
+template <unsigned TBufferSize, unsigned TMaxNumBuffers>
+struct buffer_pool_type_dispatch_helper<TBufferSize, TMaxNumBuffers, false>
+{
+    typedef SegregatedBufferPool<
+                boost::mpl::vector<buffer_class<TBufferSize, 0> > > type;
+};
+
 template <unsigned TBufferSize, unsigned TMaxNumBuffers>
 struct buffer_pool_type_dispatch_helper<TBufferSize, TMaxNumBuffers, true>
 {
-    typedef BufferPool<TBufferSize, TMaxNumBuffers> type;
+    typedef SegregatedBufferPool<
+                boost::mpl::vector<
+                    buffer_class<TBufferSize, TMaxNumBuffers> > > type;
 };
 
 // A helper struct to dispatch the type of the buffer pool for the kernel.
-template <unsigned TBufferSize, unsigned TMaxNumBuffers>
+template <unsigned TBufferSize, unsigned TMaxNumBuffers, typename TClassList>
 struct buffer_pool_type_dispatcher
 {
-    typedef typename buffer_pool_type_dispatch_helper<
-                         TBufferSize, TMaxNumBuffers,
-                         (TMaxNumBuffers > 0)>::type type;
+    typedef typename boost::mpl::eval_if<
+                boost::mpl::empty<TClassList>,
+                buffer_pool_type_dispatch_helper<TBufferSize, TMaxNumBuffers,
+                                                 (TMaxNumBuffers > 0)>,
+                boost::mpl::identity<SegregatedBufferPool<TClassList> >
+            >::type type;
 };
 
-template <unsigned TMaxNumEvents, bool TGreaterZero>
+template <unsigned TMaxNumEvents, bool TLockFree, bool TGreaterZero>
 struct event_list_type_dispatch_helper;
 
 template <unsigned TMaxNumEvents>
-struct event_list_type_dispatch_helper<TMaxNumEvents, true>
+struct event_list_type_dispatch_helper<TMaxNumEvents, false, false>
+{
+    typedef EventList<0> type;
+};
+
+template <unsigned TMaxNumEvents>
+struct event_list_type_dispatch_helper<TMaxNumEvents, true, false>
+{
+    typedef LockFreeEventList<0> type;
+};
+
+template <unsigned TMaxNumEvents>
+struct event_list_type_dispatch_helper<TMaxNumEvents, false, true>
 {
     typedef EventList<TMaxNumEvents> type;
 };
 
 template <unsigned TMaxNumEvents>
+struct event_list_type_dispatch_helper<TMaxNumEvents, true, true>
+{
+    typedef LockFreeEventList<TMaxNumEvents> type;
+};
+
+// A helper struct to dispatch the type of the event list for the kernel.
+template <unsigned TMaxNumEvents, bool TLockFree>
 struct event_list_type_dispatcher
 {
     typedef typename event_list_type_dispatch_helper<
-                         TMaxNumEvents, (TMaxNumEvents > 0)>::type type;
+                         TMaxNumEvents, TLockFree,
+                         (TMaxNumEvents > 0)>::type type;
+};
+
+template <unsigned TMaxNumRoutes, unsigned TMaxNumChunks, bool TGreaterZero>
+struct routing_table_type_dispatch_helper;
+
+template <unsigned TMaxNumRoutes, unsigned TMaxNumChunks>
+struct routing_table_type_dispatch_helper<TMaxNumRoutes, TMaxNumChunks, false>
+{
+    typedef RoutingTable<TMaxNumRoutes> type;
+};
+
+template <unsigned TMaxNumRoutes, unsigned TMaxNumChunks>
+struct routing_table_type_dispatch_helper<TMaxNumRoutes, TMaxNumChunks, true>
+{
+    typedef ForwardingTable<TMaxNumRoutes, TMaxNumChunks> type;
+};
+
+// A helper struct to dispatch the type of the routing table for the kernel.
+template <unsigned TMaxNumRoutes, unsigned TMaxNumChunks>
+struct routing_table_type_dispatcher
+{
+    typedef typename routing_table_type_dispatch_helper<
+                         TMaxNumRoutes, TMaxNumChunks,
+                         (TMaxNumChunks > 0)>::type type;
+};
+
+// A request to change a route. The routing table is only modified by the
+// event loop, which signals the completion of the request to the waiting
+// caller.
+class RouteChangeRequest
+{
+public:
+    RouteChangeRequest(bool add, NetworkAddress targetNetwork,
+                       HostAddress nextNeighbor)
+        : m_add(add),
+          m_targetNetwork(targetNetwork),
+          m_nextNeighbor(nextNeighbor),
+          m_succeeded(false),
+          m_done(0)
+    {
+    }
+
+    //! If set, the route is added. Otherwise, it is removed.
+    bool m_add;
+    //! The target network of the route.
+    NetworkAddress m_targetNetwork;
+    //! The next neighbor of an added route.
+    HostAddress m_nextNeighbor;
+    //! Set by the event loop if the route has been added or removed.
+    bool m_succeeded;
+    //! Posted by the event loop when the request has been processed.
+    OperatingSystem::semaphore m_done;
 };
 
 } // namespace detail
@@ -93,11 +260,48 @@ struct event_list_type_dispatcher
 template <typename TraitsT = default_kernel_traits>
 class Kernel : public NetworkInterfaceListener,
                public KernelBase,
-               public NcpHandler<Kernel<TraitsT> >
+               public NcpHandler<Kernel<TraitsT> >,
+               public TimerListener
 {
 public:
     typedef TraitsT traits_t;
 
+    //! The type of the buffer pool.
+    typedef typename detail::buffer_pool_type_dispatcher<
+                         traits_t::buffer_size,
+                         traits_t::max_num_buffers,
+                         typename traits_t::buffer_class_list_t>::type
+            buffer_pool_t;
+
+    //! The type of a buffer cache.
+    //! A thread which allocates many buffers, e.g. the receive thread of an
+    //! interface or an application which sends a lot, can put a cache in
+    //! front of the kernel's buffer pool:
+    //! \code
+    //! kernel_t::buffer_cache_t cache(kernel.bufferPool());
+    //! BufferBase* buffer = cache.allocate(size);
+    //! \endcode
+    //! The thread then takes its buffers from the cache and the buffers are
+    //! returned to the cache from whichever thread disposes them. Thus, the
+    //! threads do not contend for the lock of the buffer pool. The cache
+    //! is configured by the traits' buffer_cache_size. It must outlive all
+    //! buffers which have been allocated from it.
+    typedef SegregatedBufferCache<buffer_pool_t,
+                                  traits_t::buffer_cache_size>
+            buffer_cache_t;
+
+    //! The number of bytes which the buffers reserve in front of the data.
+    //! This is the size of the network protocol header plus the size of the
+    //! largest header of the attached protocols.
+    static const std::size_t headroom
+        = sizeof(NetworkProtocolHeader)
+          + (max_protocol_header_size<
+                 typename traits_t::protocol_list_t>::value
+                 > traits_t::custom_header_size
+             ? max_protocol_header_size<
+                   typename traits_t::protocol_list_t>::value
+             : traits_t::custom_header_size);
+
     //! Creates a network kernel.
     Kernel();
 
@@ -110,10 +314,22 @@ public:
 
     //! Adds a static route.
     //! Adds a static entry to the routing table which routes packets for
-    //! the \p targetNetwork via the \p nextNeighbor.
+    //! the \p targetNetwork via the \p nextNeighbor. If there is already a
+    //! route for the \p targetNetwork, it is replaced. If the routing table
+    //! is full, an exception is thrown.
+    //!
+    //! The route is changed by the event loop. The calling thread is blocked
+    //! until the change has been applied. Thus, this method must not be
+    //! called from the event loop, e.g. by a protocol handler.
     void addStaticRoute(NetworkAddress targetNetwork,
                         HostAddress nextNeighbor);
 
+    //! Removes a static route.
+    //! Removes the route for the \p targetNetwork from the routing table.
+    //! Returns \p true, if such a route existed. Like addStaticRoute(), this
+    //! method must not be called from the event loop.
+    bool removeStaticRoute(NetworkAddress targetNetwork);
+
     //! Returns a protocol handler.
     template <typename TProtocol>
     TProtocol* protocolHandler()
@@ -129,17 +345,94 @@ public:
     //! header.
     void send(HostAddress destination, std::uint8_t headerType, BufferBase& packet);
 
+    //! \reimp
+    virtual void confirmReachability(HostAddress neighbor);
+
+    //! \reimp
+    virtual void sendCongestionNotification(HostAddress destination,
+                                            std::uint8_t headerType,
+                                            std::uint8_t port);
+
     //! \reimp
     virtual BufferBase* allocateBuffer()
     {
         return m_bufferPool.allocate();
     }
 
+    //! Allocates a buffer.
+    //! Allocates a buffer from the smallest size class which can hold
+    //! \p sizeHint bytes of data in addition to the headers. The calling
+    //! thread is blocked until a buffer is available.
+    BufferBase* allocateBuffer(std::size_t sizeHint)
+    {
+        return m_bufferPool.allocate(sizeHint);
+    }
+
     virtual BufferBase* tryAllocateBuffer()
     {
         return m_bufferPool.try_allocate();
     }
 
+    //! Tries to allocate a buffer.
+    //! Allocates a buffer from the smallest size class which can hold
+    //! \p sizeHint bytes of data in addition to the headers. If no such
+    //! buffer is available, a null-pointer is returned.
+    BufferBase* tryAllocateBuffer(std::size_t sizeHint)
+    {
+        return m_bufferPool.try_allocate(sizeHint);
+    }
+
+    //! Returns the allocator of the buffer pool.
+    //! The allocator can be used to create a BufferChain for a packet which
+    //! does not fit into a single buffer.
+    BufferAllocator& bufferAllocator()
+    {
+        return m_bufferPool;
+    }
+
+    //! Returns the buffer pool.
+    //! The pool is needed to create a buffer cache (see buffer_cache_t).
+    buffer_pool_t& bufferPool()
+    {
+        return m_bufferPool;
+    }
+
+    //! Returns the statistics of the buffer pool accumulated over all
+    //! size classes.
+    BufferPoolStatistics bufferPoolStatistics() const
+    {
+        return m_bufferPool.statistics();
+    }
+
+    //! Returns the statistics of the size class with the index \p sizeClass
+    //! of the buffer pool.
+    BufferPoolStatistics bufferPoolStatistics(unsigned sizeClass) const
+    {
+        return m_bufferPool.statistics(sizeClass);
+    }
+
+    //! Returns the statistics of the control buffer pool.
+    BufferPoolStatistics controlBufferPoolStatistics() const
+    {
+        return m_controlBufferPool.statistics();
+    }
+
+    //! Returns the number of times a multicast packet has not been sent
+    //! on an interface because no buffer was available for it.
+    unsigned numSkippedMulticasts() const
+    {
+        return m_numSkippedMulticasts.load(std::memory_order_relaxed);
+    }
+
+    //! Releases unused buffer memory.
+    //! If the buffer pool is unlimited, the memory which has been allocated
+    //! during a burst is returned to the heap until at most \p maxNumFree
+    //! buffers per size class remain free. Otherwise, nothing happens.
+    void trimBufferPool(std::size_t maxNumFree = 0)
+    {
+        m_bufferPool.trim(maxNumFree);
+    }
+
     //! \reimp
     virtual void notify(const Event& event)
     {
@@ -147,32 +440,104 @@ public:
     }
 
 
+    //! \internal
+    //! Passes a congestion notification from the \p source on to the
+    //! protocol handler of the \p headerType. This method must only be
+    //! called from the event loop.
+    void receiveCongestionNotification(HostAddress source,
+                                       std::uint8_t headerType,
+                                       std::uint8_t port)
+    {
+        m_protocolChain.dispatchCongestionNotification(source, headerType,
+                                                       port);
+    }
+
     //! \internal
     void sendFromEventLoop(NetworkInterface* ifc, LinkLayerAddress linkLayerAddress, BufferBase& packet);
 
     void sendFromEventLoop(BufferBase& packet);
 
+    //! \internal
+    //! Starts a timer.
+    //! Starts the \p timer such that it expires after \p milliseconds. The
+    //! timeout is rounded up to the next timer tick. When the timer expires,
+    //! the \p listener is notified from the event loop. This method must only
+    //! be called from the event loop.
+    void startTimer(Timer& timer, std::uint32_t milliseconds,
+                    TimerListener* listener)
+    {
+        m_timerWheel.start(timer,
+                           (milliseconds + traits_t::timer_tick_ms - 1)
+                           / traits_t::timer_tick_ms,
+                           listener);
+    }
+
+    //! \internal
+    //! Stops a timer.
+    //! Stops the \p timer. This method must only be called from the event
+    //! loop.
+    void stopTimer(Timer& timer)
+    {
+        m_timerWheel.stop(timer);
+    }
+
+    //! \internal
+    //! Creates a neighbor.
+    //! Creates an entry in the neighbor cache for the neighbor with the
+    //! given \p address which is reachable via the interface \p ifc. Returns
+    //! a null-pointer, if the neighbor cache is full.
+    Neighbor* createNeighbor(HostAddress address, NetworkInterface* ifc);
+
+    //! \internal
+    //! Marks a neighbor as reachable.
+    //! Moves the \p neighbor to the Reachable state and sends the packets
+    //! which have been queued for it.
+    void setNeighborReachable(Neighbor& neighbor);
+
+    //! \internal
+    //! Marks a neighbor as stale.
+    //! Moves the \p neighbor to the Stale state and sends the packets which
+    //! have been queued for it.
+    void setNeighborStale(Neighbor& neighbor);
+
 private:
-    //! The type of the buffer pool.
-    typedef typename detail::buffer_pool_type_dispatcher<
-                         traits_t::buffer_size,
-                         traits_t::max_num_buffers>::type buffer_pool_t;
     //! The pool from which buffers are allocated.
     buffer_pool_t m_bufferPool;
 
+    //! The pool from which buffers for network control messages are
+    //! allocated.
+    BufferPool<traits_t::control_buffer_size,
+               traits_t::max_num_control_buffers> m_controlBufferPool;
+
     //! The type of the event list.
     typedef typename detail::event_list_type_dispatcher<
-                         traits_t::max_num_events>::type event_list_t;
+                         traits_t::max_num_events,
+                         traits_t::lock_free_event_list>::type event_list_t;
     //! The list of events which has to be processed.
     event_list_t m_eventList;
 
+    //! The timers which are handled by the event loop.
+    TimerWheel<> m_timerWheel;
+
+    //! The number of interfaces on which a multicast has not been sent.
+    std::atomic<unsigned> m_numSkippedMulticasts;
+
     //! A thread to process the events.
     OperatingSystem::thread m_eventThread;
 
     //! The interfaces which have been registered in the kernel.
     NetworkInterface* m_interfaces[traits_t::max_num_interfaces];
 
-    RoutingTable m_routingTable;
+    //! The type of the routing table.
+    typedef typename detail::routing_table_type_dispatcher<
+                         traits_t::max_num_routes,
+                         traits_t::max_num_forwarding_table_chunks>::type
+                         routing_table_t;
+    //! The routing table.
+    routing_table_t m_routingTable;
+
+    //! Caches the next neighbor for recently used destinations.
+    DestinationCache<traits_t::max_num_cached_destinations> m_destinationCache;
 
     //! The type of the protocol chain.
     typedef typename make_protocol_handler_chain<
@@ -182,22 +547,45 @@ private:
     protocol_chain_t m_protocolChain;
 
     void eventLoop();
+    std::uint32_t currentTick() const;
     void handlePacketReceiveEvent(const Event& event);
     void handlePacketSendEvent(const Event& event);
 
     void handleSendLinkLocalBroadcastEvent(const Event& event);
+    void handleRouteChangeEvent(const Event& event);
+    bool changeRoute(bool add, NetworkAddress targetNetwork,
+                     HostAddress nextNeighbor);
+
+    //! \reimp
+    virtual void timerExpired(Timer& timer);
 
-    void sendNeighborSolicitation(NetworkInterface* ifc, HostAddress destAddr);
+    void sendMulticast(BufferBase& packet);
+    void sendToNeighbor(Neighbor& neighbor, BufferBase& packet);
+    void flushSendQueue(Neighbor& neighbor);
+    void removeNeighbor(Neighbor& neighbor);
+    void sendNeighborSolicitation(Neighbor& neighbor);
 
 public:
-    //! \todo This needs to be combined with a destination cache and the routing table.
+    //! The neighbor cache.
     NeighborCache<traits_t::max_num_cached_neighbors> nc;
 };
 
+template <typename TraitsT>
+const std::size_t Kernel<TraitsT>::headroom;
+
 template <typename TraitsT>
 Kernel<TraitsT>::Kernel()
-    : m_eventThread(&Kernel::eventLoop, this)
+    : m_bufferPool(headroom),
+      m_controlBufferPool(sizeof(NetworkProtocolHeader)),
+      m_timerWheel(currentTick()),
+      m_numSkippedMulticasts(0),
+      m_eventThread(&Kernel::eventLoop, this)
 {
+    // The headers of the attached protocols must fit into every buffer.
+    BOOST_STATIC_ASSERT(headroom < buffer_pool_t::min_buffer_size);
+    BOOST_STATIC_ASSERT(sizeof(NetworkProtocolHeader)
+                        < traits_t::control_buffer_size);
+
     for (unsigned idx = 0; idx < traits_t::max_num_interfaces; ++idx)
         m_interfaces[idx] = 0;
 
@@ -228,7 +616,27 @@ template <typename TraitsT>
 void Kernel<TraitsT>::addStaticRoute(NetworkAddress targetNetwork,
                                      HostAddress nextNeighbor)
 {
-    m_routingTable.addStaticRoute(targetNetwork, nextNeighbor);
+    if (!changeRoute(true, targetNetwork, nextNeighbor))
+        ::uNet::throw_exception(-1);//! \todo system_error()
+}
+
+template <typename TraitsT>
+bool Kernel<TraitsT>::removeStaticRoute(NetworkAddress targetNetwork)
+{
+    return changeRoute(false, targetNetwork, HostAddress());
+}
+
+// Hands a route change over to the event loop and waits until it has been
+// applied. Thus, the routing table is never modified while the event loop
+// resolves an address.
+template <typename TraitsT>
+bool Kernel<TraitsT>::changeRoute(bool add, NetworkAddress targetNetwork,
+                                  HostAddress nextNeighbor)
+{
+    detail::RouteChangeRequest change(add, targetNetwork, nextNeighbor);
+    m_eventList.copy_enqueue(Event::createRouteChangeEvent(&change));
+    change.m_done.wait();
+    return change.m_succeeded;
 }
 
 template <typename TraitsT>
@@ -242,11 +650,46 @@ void Kernel<TraitsT>::send(HostAddress destination, std::uint8_t headerType,
     NetworkProtocolHeader header;
     header.destinationAddress = destination;
     header.nextHeader = headerType;
-    header.length = packet.size() + sizeof(NetworkProtocolHeader);
+    header.length = packet.totalSize() + sizeof(NetworkProtocolHeader);
     packet.push_front(header);
     m_eventList.copy_enqueue(Event::createMessageSendEvent(&packet));
 }
 
+template <typename TraitsT>
+void Kernel<TraitsT>::confirmReachability(HostAddress neighbor)
+{
+    // An incomplete neighbor cannot be confirmed as its link-layer address
+    // is still unknown.
+    Neighbor* cachedNeighbor = nc.find(neighbor);
+    if (cachedNeighbor && cachedNeighbor->state() != Neighbor::Incomplete)
+        setNeighborReachable(*cachedNeighbor);
+}
+
+template <typename TraitsT>
+void Kernel<TraitsT>::sendCongestionNotification(HostAddress destination,
+                                                 std::uint8_t headerType,
+                                                 std::uint8_t port)
+{
+    if (destination.unspecified() || destination.multicast())
+        return;
+
+    // Like a neighbor solicitation, the notification must neither block
+    // the event loop nor compete with the user for buffers.
+    BufferBase* buffer = m_controlBufferPool.try_allocate();
+    if (!buffer)
+        return;
+
+    NetworkControlProtocolMessageBuilder builder(*buffer);
+    builder.createCongestionNotification(headerType, port);
+
+    NetworkProtocolHeader header;
+    header.destinationAddress = destination;
+    header.nextHeader = 1;
+    header.length = buffer->size() + sizeof(NetworkProtocolHeader);
+    buffer->push_front(header);
+    sendFromEventLoop(*buffer);
+}
+
 template <typename TraitsT>
 void Kernel<TraitsT>::sendFromEventLoop(NetworkInterface* ifc,
                                         LinkLayerAddress linkLayerAddress,
@@ -260,6 +703,14 @@ void Kernel<TraitsT>::sendFromEventLoop(NetworkInterface* ifc,
     if (destinationAddress.unspecified())
         ::uNet::throw_exception(-1);//! \todo Use a system_error
 
+    // A chained packet can only be sent by an interface which gathers the
+    // segments.
+    if (packet.nextSegment() && !ifc->supportsGather())
+    {
+        packet.dispose();
+        return;
+    }
+
     detail::setNetworkProtocolSourceAddress(
                 packet.begin(), ifc->networkAddress().hostAddress());
 
@@ -287,59 +738,33 @@ void Kernel<TraitsT>::sendFromEventLoop(BufferBase& packet)
 
     if (destinationAddress.multicast())
     {
-        for (unsigned idx = 0; idx < traits_t::max_num_interfaces; ++idx)
-        {
-            NetworkInterface* ifc = m_interfaces[idx];
-            if (!ifc)
-                break;
-            sendFromEventLoop(ifc, LinkLayerAddress(), packet);
-            //! \todo Copy the packet and continue with the next interface.
-            return;
-        }
-        packet.dispose();
+        sendMulticast(packet);
         return;
     }
 
-#if 0
     // Perform a look-up in the destination cache.
-    Neighbor* nextHopInfo = m_nextHopCache.lookupDestination(destination);
-    if (nextHopInfo)
-    {
-        UnetHeader header;
-        header.destinationAddress = destination;
-        header.sourceAddress = nextHopInfo->interface()->networkAddress().hostAddress();
-        message.push_front((uint8_t*)&header, sizeof(header));
-        sendToNeighbor(nextHopInfo, message);
+    Neighbor* cachedNeighbor = m_destinationCache.lookup(destinationAddress);
+    if (cachedNeighbor)
+    {
+        sendToNeighbor(*cachedNeighbor, packet);
         return;
     }
-#endif
 
     // We have not found an entry in the destination cache. The next step is to
     // consult the routing table, which will map the destination address to
-    // the one of the next neighbor.
+    // the one of the next neighbor. The generation of the destination cache
+    // is read beforehand such that the result is not cached if a route
+    // changes during the look-up.
+    std::uint32_t cacheGeneration = m_destinationCache.generation();
     HostAddress routedDestination = m_routingTable.resolve(destinationAddress);
 
     // Look up the neighbor in the cache.
-    Neighbor* cachedNeighbor = nc.find(routedDestination);
+    cachedNeighbor = nc.find(routedDestination);
     if (cachedNeighbor)
     {
-        switch (cachedNeighbor->state())
-        {
-            case Neighbor::Incomplete:
-            case Neighbor::Probe:
-                cachedNeighbor->sendQueue().push_back(packet);
-                break;
-            case Neighbor::Reachable:
-                sendFromEventLoop(cachedNeighbor->networkInterface(),
-                                  cachedNeighbor->linkLayerAddress(),
-                                  packet);
-                break;
-            case Neighbor::Stale:
-                // We are not completely sure if the neighbor is reachable.
-                // We transmit the packet.
-                UNET_ASSERT(0 && "Not implemented, yet.");
-        }
-
+        m_destinationCache.cache(destinationAddress, cachedNeighbor,
+                                 cacheGeneration);
+        sendToNeighbor(*cachedNeighbor, packet);
         return;
     }
 
@@ -373,18 +798,25 @@ void Kernel<TraitsT>::sendFromEventLoop(BufferBase& packet)
             return;
         }
 
-        cachedNeighbor = nc.createEntry(routedDestination, ifc);
-        /*
-            nextHopInfo = m_nextHopCache.createNeighborCacheEntry(
-                              routedDestination, ifc);
-        */
+        cachedNeighbor = createNeighbor(routedDestination, ifc);
+        if (!cachedNeighbor)
+        {
+            // The neighbor cache is full.
+            packet.dispose();
+            return;
+        }
+        // Creating the neighbor may have invalidated the destination cache.
+        // As routes are only changed by the event loop, the new neighbor
+        // can be cached in the current generation.
+        m_destinationCache.cache(destinationAddress, cachedNeighbor,
+                                 m_destinationCache.generation());
 
         // Put the packet in the neighbor's queue. It will be sent when we
         // receive a Neighbor Advertisment.
         cachedNeighbor->sendQueue().push_back(packet);
 
         // Send out a Neighbor Solicitation.
-        sendNeighborSolicitation(ifc, routedDestination);
+        sendNeighborSolicitation(*cachedNeighbor);
         return;
     }
 
@@ -393,39 +825,299 @@ void Kernel<TraitsT>::sendFromEventLoop(BufferBase& packet)
     packet.dispose();
 }
 
+template <typename TraitsT>
+void Kernel<TraitsT>::sendMulticast(BufferBase& packet)
+{
+    // Every interface sends the packet with its own source address. Instead
+    // of copying the payload, every interface which gathers gets a header
+    // segment of its own, which is chained in front of the shared payload.
+    // Every interface drops one reference to the payload when it disposes
+    // its header. An interface which cannot gather gets a copy of the
+    // packet if it fits into a single buffer. The buffers are allocated
+    // without blocking and the control buffers are left for the network
+    // control messages. If no buffer is available, the packet is not sent
+    // on that interface.
+    NetworkProtocolHeader header = packet.pop_front<NetworkProtocolHeader>();
+    std::size_t payloadSize = packet.totalSize();
+
+    NetworkInterface* interfaces[traits_t::max_num_interfaces];
+    BufferBase* buffers[traits_t::max_num_interfaces];
+    unsigned numInterfaces = 0;
+    unsigned numShared = 0;
+    for (unsigned idx = 0; idx < traits_t::max_num_interfaces; ++idx)
+    {
+        NetworkInterface* ifc = m_interfaces[idx];
+        if (!ifc)
+            break;
+
+        BufferBase* buffer;
+        if (ifc->supportsGather())
+        {
+            buffer = m_bufferPool.try_allocate(0);
+            if (buffer)
+            {
+                buffer->setNextSegment(&packet);
+                ++numShared;
+            }
+        }
+        else
+        {
+            buffer = m_bufferPool.try_allocate(payloadSize);
+            if (buffer && buffer->back_capacity() < payloadSize)
+            {
+                buffer->dispose();
+                buffer = 0;
+            }
+            for (BufferBase* segment = &packet; buffer && segment;
+                 segment = segment->nextSegment())
+            {
+                buffer->append(segment->begin(), segment->size());
+            }
+        }
+
+        if (!buffer)
+        {
+            m_numSkippedMulticasts.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        buffer->push_front(header);
+        interfaces[numInterfaces] = ifc;
+        buffers[numInterfaces] = buffer;
+        ++numInterfaces;
+    }
+
+    // The payload must be shared before the first interface can dispose
+    // its header.
+    if (numShared == 0)
+        packet.dispose();
+    else
+        packet.share(numShared - 1);
+
+    for (unsigned idx = 0; idx < numInterfaces; ++idx)
+        sendFromEventLoop(interfaces[idx], LinkLayerAddress(), *buffers[idx]);
+}
+
+template <typename TraitsT>
+Neighbor* Kernel<TraitsT>::createNeighbor(HostAddress address,
+                                          NetworkInterface* ifc)
+{
+    // If the neighbor cache evicts another neighbor, the latter can still be
+    // referenced from the destination cache.
+    bool evicted;
+    Neighbor* neighbor = nc.createEntry(address, ifc, &evicted);
+    if (evicted)
+        m_destinationCache.invalidate();
+    return neighbor;
+}
+
+template <typename TraitsT>
+void Kernel<TraitsT>::setNeighborReachable(Neighbor& neighbor)
+{
+    neighbor.setState(Neighbor::Reachable);
+    neighbor.setNumSolicitations(0);
+    startTimer(neighbor, traits_t::neighbor_reachable_time_ms, this);
+    flushSendQueue(neighbor);
+}
+
+template <typename TraitsT>
+void Kernel<TraitsT>::setNeighborStale(Neighbor& neighbor)
+{
+    stopTimer(neighbor);
+    neighbor.setState(Neighbor::Stale);
+    neighbor.setNumSolicitations(0);
+    flushSendQueue(neighbor);
+}
+
 // ----=====================================================================----
 //     Private methods
 // ----=====================================================================----
 
+template <typename TraitsT>
+void Kernel<TraitsT>::timerExpired(Timer& timer)
+{
+    // The kernel starts timers only for neighbors.
+    Neighbor& neighbor = static_cast<Neighbor&>(timer);
+
+    switch (neighbor.state())
+    {
+        case Neighbor::Incomplete:
+        case Neighbor::Probe:
+            // The retransmit timer has expired. If the neighbor has not
+            // answered any of our solicitations, it is considered to be
+            // unreachable.
+            if (neighbor.numSolicitations()
+                < traits_t::max_num_neighbor_solicitations)
+            {
+                sendNeighborSolicitation(neighbor);
+            }
+            else
+            {
+                removeNeighbor(neighbor);
+            }
+            break;
+        case Neighbor::Reachable:
+            // The reachability has not been confirmed for some time.
+            neighbor.setState(Neighbor::Stale);
+            break;
+        case Neighbor::Delay:
+            // No upper layer has confirmed the reachability. Start probing
+            // the neighbor.
+            neighbor.setState(Neighbor::Probe);
+            neighbor.setNumSolicitations(0);
+            sendNeighborSolicitation(neighbor);
+            break;
+        case Neighbor::Stale:
+            UNET_ASSERT(0 && "A stale neighbor has no timer.");
+            break;
+    }
+}
+
+// Sends a packet to a neighbor depending on its discovery state.
+template <typename TraitsT>
+void Kernel<TraitsT>::sendToNeighbor(Neighbor& neighbor, BufferBase& packet)
+{
+    switch (neighbor.state())
+    {
+        case Neighbor::Incomplete:
+            // The link-layer address is not known, yet. The packet is sent
+            // when the neighbor has answered or dropped together with it.
+            neighbor.sendQueue().push_back(packet);
+            break;
+        case Neighbor::Stale:
+            // We are not completely sure if the neighbor is reachable. We
+            // transmit the packet but start probing the neighbor unless an
+            // upper layer confirms its reachability in the meantime.
+            neighbor.setState(Neighbor::Delay);
+            startTimer(neighbor, traits_t::neighbor_delay_time_ms, this);
+            // Fall through
+        case Neighbor::Reachable:
+        case Neighbor::Delay:
+        case Neighbor::Probe:
+            // The cached link-layer address remains valid while the
+            // neighbor is probed (RFC 4861, section 7.3.3).
+            sendFromEventLoop(neighbor.networkInterface(),
+                              neighbor.linkLayerAddress(),
+                              packet);
+            break;
+    }
+}
+
+// Sends the packets which have been queued for a neighbor.
+template <typename TraitsT>
+void Kernel<TraitsT>::flushSendQueue(Neighbor& neighbor)
+{
+    while (   !neighbor.sendQueue().empty()
+           && neighbor.state() != Neighbor::Incomplete)
+    {
+        BufferBase& buffer = neighbor.sendQueue().front();
+        neighbor.sendQueue().pop_front();
+        sendToNeighbor(neighbor, buffer);
+    }
+}
+
+// Removes an unreachable neighbor and drops the packets queued for it.
+template <typename TraitsT>
+void Kernel<TraitsT>::removeNeighbor(Neighbor& neighbor)
+{
+    stopTimer(neighbor);
+    while (!neighbor.sendQueue().empty())
+    {
+        BufferBase& buffer = neighbor.sendQueue().front();
+        neighbor.sendQueue().pop_front();
+        // diagnostics.unreachableNeighbor(neighbor.address());
+        buffer.dispose();
+    }
+    nc.removeEntry(&neighbor);
+    m_destinationCache.invalidate();
+}
+
 template <typename TraitsT>
 void Kernel<TraitsT>::eventLoop()
 {
     bool stopEventThread = false;
     while (!stopEventThread)
     {
-        Event event = m_eventList.retrieve();
+        // Detach all pending events at once. The batch is processed without
+        // synchronizing with the producers again. If a timer is active, we
+        // must not wait longer than until its expiry.
+        Event* event;
+        if (m_timerWheel.empty())
+        {
+            event = m_eventList.retrieve_all();
+        }
+        else
+        {
+            event = m_eventList.try_retrieve_all_for(
+                        OperatingSystem::chrono::milliseconds(
+                            m_timerWheel.ticksUntilNextExpiry()
+                            * traits_t::timer_tick_ms));
+        }
 
-        switch (event.type())
+        // Fire the timers which have expired in the meantime. This also
+        // brings the wheel up to date before the events start new timers.
+        m_timerWheel.advance(currentTick());
+        while (event)
         {
-            case Event::MessageReceive:
-                handlePacketReceiveEvent(event);
-                break;
-            case Event::MessageSend:
-                handlePacketSendEvent(event);
-                break;
-            case Event::StopKernel:
-                stopEventThread = true;
-                break;
-
-            case Event::SendLinkLocalBroadcast:
-                handleSendLinkLocalBroadcastEvent(event);
-                break;
-            default:
-                break;
+            // Copy the event and give its slot back right away such that
+            // the producers are not starved while the batch is processed.
+            Event* next = event->next();
+            Event current(*event);
+            m_eventList.destroy(event);
+            event = next;
+
+            // Events which follow a stop request are discarded. Their
+            // buffers must not be leaked, though. A route change is still
+            // applied as its caller waits for it.
+            if (stopEventThread)
+            {
+                if (   current.type() == Event::MessageReceive
+                    || current.type() == Event::MessageSend)
+                {
+                    current.buffer()->dispose();
+                }
+                else if (current.type() == Event::RouteChange)
+                {
+                    handleRouteChangeEvent(current);
+                }
+                continue;
+            }
+
+            switch (current.type())
+            {
+                case Event::MessageReceive:
+                    handlePacketReceiveEvent(current);
+                    break;
+                case Event::MessageSend:
+                    handlePacketSendEvent(current);
+                    break;
+                case Event::StopKernel:
+                    stopEventThread = true;
+                    break;
+
+                case Event::SendLinkLocalBroadcast:
+                    handleSendLinkLocalBroadcastEvent(current);
+                    break;
+                case Event::RouteChange:
+                    handleRouteChangeEvent(current);
+                    break;
+                default:
+                    break;
+            }
         }
     }
 }
 
+// Returns the current time in timer ticks.
+template <typename TraitsT>
+std::uint32_t Kernel<TraitsT>::currentTick() const
+{
+    using namespace OperatingSystem::chrono;
+    return static_cast<std::uint32_t>(
+                duration_cast<milliseconds>(
+                    steady_clock::now().time_since_epoch()).count()
+                / traits_t::timer_tick_ms);
+}
+
 template <typename TraitsT>
 void Kernel<TraitsT>::handlePacketReceiveEvent(const Event& event)
 {
@@ -504,16 +1196,45 @@ void Kernel<TraitsT>::handlePacketSendEvent(const Event& event)
 }
 
 template <typename TraitsT>
-void Kernel<TraitsT>::sendNeighborSolicitation(NetworkInterface* ifc,
-                                               HostAddress destAddr)
+void Kernel<TraitsT>::handleRouteChangeEvent(const Event& event)
+{
+    detail::RouteChangeRequest* change = event.routeChange();
+    UNET_ASSERT(change);
+    if (change->m_add)
+    {
+        change->m_succeeded = m_routingTable.tryAddStaticRoute(
+                                  change->m_targetNetwork,
+                                  change->m_nextNeighbor);
+    }
+    else
+    {
+        change->m_succeeded = m_routingTable.removeStaticRoute(
+                                  change->m_targetNetwork);
+    }
+    m_destinationCache.invalidate();
+    change->m_done.post();
+}
+
+// Sends a neighbor solicitation and starts the retransmit timer. An
+// incomplete neighbor is solicited via multicast, a neighbor which is probed
+// via unicast to its cached link-layer address.
+template <typename TraitsT>
+void Kernel<TraitsT>::sendNeighborSolicitation(Neighbor& neighbor)
 {
-    //! \todo This is a blocking allocation. When all buffers are taken,
-    //! we run into a deadlock here. A solution might be to keep a list
-    //! of pending solicitations in the kernel and periodically try to
-    //! send them.
-    //! Another possibility is to have a internal buffer pool soley for the
-    //! purpose of sending neighbor solicitations.
-    BufferBase* buffer = allocateBuffer();
+    NetworkInterface* ifc = neighbor.networkInterface();
+    HostAddress destAddr = neighbor.address();
+    bool probe = neighbor.state() == Neighbor::Probe;
+
+    // The solicitation counts as sent even if no buffer is available. The
+    // retransmit timer will try again later.
+    neighbor.setNumSolicitations(neighbor.numSolicitations() + 1);
+    startTimer(neighbor, traits_t::neighbor_retransmit_time_ms, this);
+
+    // The buffer is taken from the control pool without blocking such that
+    // user data can neither starve nor deadlock the event loop.
+    BufferBase* buffer = m_controlBufferPool.try_allocate();
+    if (!buffer)
+        return;
 
     NetworkControlProtocolMessageBuilder builder(*buffer);
     builder.createNeighborSolicitation(destAddr);
@@ -524,12 +1245,20 @@ void Kernel<TraitsT>::sendNeighborSolicitation(NetworkInterface* ifc,
 
     NetworkProtocolHeader header;
     header.sourceAddress = ifc->networkAddress().hostAddress();
-    header.destinationAddress = HostAddress::multicastAddress(
-                                    link_local_all_device_multicast);
+    header.destinationAddress
+            = probe ? destAddr
+                    : HostAddress::multicastAddress(
+                          link_local_all_device_multicast);
     header.nextHeader = 1;
     header.length = buffer->size() + sizeof(NetworkProtocolHeader);
     buffer->push_front(header);
 
+    if (probe)
+    {
+        ifc->send(neighbor.linkLayerAddress(), *buffer);
+        return;
+    }
+
     std::pair<bool, LinkLayerAddress> lla
             = ifc->neighborLinkLayerAddress(destAddr);
     if (lla.first)
@@ -27,6 +27,29 @@ public:
     virtual void send(HostAddress destination, std::uint8_t headerType,
                       BufferBase& packet) = 0;
 
+    //! Confirms the reachability of a neighbor.
+    //! An upper layer protocol calls this method when it has received
+    //! evidence that the \p neighbor is reachable, e.g. an acknowledgement
+    //! of a previously sent packet. This saves the neighbor solicitations
+    //! which would be sent otherwise. Nothing happens, if the neighbor is
+    //! unknown.
+    //! \note This method must only be called from the kernel's event loop,
+    //! i.e. from within a protocol handler.
+    virtual void confirmReachability(HostAddress neighbor) = 0;
+
+    //! Notifies a sender about congestion.
+    //! An upper layer protocol calls this method when it has dropped a
+    //! packet from the \p destination because a receive queue was full. An
+    //! NCP congestion notification is sent back, which contains the
+    //! protocol's \p headerType and the \p port from which the packet has
+    //! been sent. The notification is not sent, if no control buffer is
+    //! available.
+    //! \note This method must only be called from the kernel's event loop,
+    //! i.e. from within a protocol handler.
+    virtual void sendCongestionNotification(HostAddress destination,
+                                            std::uint8_t headerType,
+                                            std::uint8_t port) = 0;
+
 protected:
 
 };
@@ -0,0 +1,226 @@
+#ifndef UNET_LOCKFREEEVENTLIST_HPP
+#define UNET_LOCKFREEEVENTLIST_HPP
+
+#include "config.hpp"
+
+#include "event.hpp"
+
+#include <OperatingSystem/OperatingSystem.h>
+
+#include <atomic>
+
+namespace uNet
+{
+
+//! A lock-free event list.
+//! The LockFreeEventList is an intrusive multiple-producer/single-consumer
+//! queue of events. Any thread may enqueue events but only a single thread
+//! (the kernel's event loop) may retrieve them. As in the EventList, a
+//! \p MaxNumEventsT of zero makes the list unlimited.
+//!
+//! Producers push an event onto an atomic stack with a single
+//! compare-and-swap. The consumer detaches the whole stack with one atomic
+//! exchange and reverses it into a private list, from which the events are
+//! retrieved in the order in which they have been enqueued. In contrast to a
+//! queue which exchanges a shared tail pointer, an enqueued event is never
+//! visible to the consumer before it is linked. A producer which is
+//! preempted in the middle of an enqueue operation can therefore not stall
+//! the consumer.
+//!
+//! The semaphore is only touched when the consumer has found the list empty
+//! and parked itself. In this case, the producer which replaces the park
+//! marker wakes the consumer up.
+template <unsigned MaxNumEventsT>
+class LockFreeEventList
+{
+public:
+    LockFreeEventList()
+        : m_head(0),
+          m_pending(0)
+    {
+    }
+
+    Event* try_construct()
+    {
+        return m_eventPool.try_construct();
+    }
+
+    void destroy(Event* ev)
+    {
+        m_eventPool.destroy(ev);
+    }
+
+    void enqueue(Event* event)
+    {
+        UNET_ASSERT(event->type() != Event::Invalid);
+        UNET_ASSERT(event->m_next == 0);
+
+        Event* head = m_head.load(std::memory_order_relaxed);
+        do
+        {
+            // If the consumer is parked, the new event becomes the only one
+            // in the list.
+            event->m_next = head == parkMarker() ? 0 : head;
+        } while (!m_head.compare_exchange_weak(head, event,
+                                               std::memory_order_release,
+                                               std::memory_order_relaxed));
+
+        if (head == parkMarker())
+            m_consumerWakeup.post();
+    }
+
+    //! Adds the copy of an event.
+    //! Copies the \p event and adds the copy to the list.
+    void copy_enqueue(const Event& event)
+    {
+        UNET_ASSERT(event.type() != Event::Invalid);
+
+        Event* ev = m_eventPool.construct();
+        *ev = event;
+        this->enqueue(ev);
+    }
+
+    //! Retrieves the oldest event.
+    //! Removes the oldest event from the list and returns a copy of it. If
+    //! the list is empty, the calling thread is blocked until an event is
+    //! enqueued.
+    //!
+    //! \note This method must only be called from a single thread.
+    Event retrieve()
+    {
+        if (!m_pending)
+            m_pending = detach();
+
+        Event* first = m_pending;
+        m_pending = first->m_next;
+        first->m_next = 0;
+
+        Event temp = *first;
+        m_eventPool.destroy(first);
+        return temp;
+    }
+
+    //! Retrieves all events.
+    //! Detaches all events from the list and returns a pointer to the oldest
+    //! one. The remaining events can be reached via Event::next(). If the
+    //! list is empty, the calling thread is blocked until an event is
+    //! enqueued. Every event has to be returned with destroy() after it
+    //! has been processed.
+    //!
+    //! \note This method must only be called from a single thread.
+    Event* retrieve_all()
+    {
+        Event* first = m_pending ? m_pending : detach();
+        m_pending = 0;
+        return first;
+    }
+
+    //! Retrieves all events with a timeout.
+    //! Behaves like retrieve_all() but blocks the calling thread at most for
+    //! the given \p duration. Returns a null-pointer, if no event has been
+    //! enqueued in this time.
+    //!
+    //! \note This method must only be called from a single thread.
+    template <typename RepT, typename PeriodT>
+    Event* try_retrieve_all_for(
+            const OperatingSystem::chrono::duration<RepT, PeriodT>& duration)
+    {
+        if (m_pending)
+        {
+            Event* first = m_pending;
+            m_pending = 0;
+            return first;
+        }
+
+        Event* head = m_head.exchange(0, std::memory_order_acquire);
+        if (head)
+            return reverse(head);
+
+        // Park the consumer unless a producer has been faster.
+        Event* expected = 0;
+        if (!m_head.compare_exchange_strong(expected, parkMarker(),
+                                            std::memory_order_acq_rel,
+                                            std::memory_order_relaxed))
+        {
+            return reverse(m_head.exchange(0, std::memory_order_acquire));
+        }
+
+        if (!m_consumerWakeup.try_wait_for(duration))
+        {
+            // Remove the park marker. If this fails, a producer has replaced
+            // the marker in the meantime and posts the semaphore, which
+            // has to be consumed.
+            expected = parkMarker();
+            if (m_head.compare_exchange_strong(expected, 0,
+                                               std::memory_order_acq_rel,
+                                               std::memory_order_relaxed))
+            {
+                return 0;
+            }
+            m_consumerWakeup.wait();
+        }
+
+        return reverse(m_head.exchange(0, std::memory_order_acquire));
+    }
+
+private:
+    //! The most recently enqueued event or the park marker. The events are
+    //! linked in reverse order.
+    std::atomic<Event*> m_head;
+    //! Events which have been detached by the consumer but not retrieved,
+    //! yet. These are linked in the order in which they have been enqueued.
+    Event* m_pending;
+    //! A pool for allocating events.
+    typename detail::object_pool_type_dispatcher<
+                 Event, MaxNumEventsT>::type m_eventPool;
+    //! Wakes up the consumer after it has been parked.
+    OperatingSystem::semaphore m_consumerWakeup;
+
+    //! Returns the marker which signals that the consumer is parked.
+    //! The marker is never dereferenced.
+    Event* parkMarker()
+    {
+        return reinterpret_cast<Event*>(&m_head);
+    }
+
+    //! Detaches all enqueued events.
+    //! Detaches all events from the shared list and returns them in the
+    //! order in which they have been enqueued. The calling thread is blocked
+    //! until at least one event is available.
+    Event* detach()
+    {
+        for (;;)
+        {
+            Event* head = m_head.exchange(0, std::memory_order_acquire);
+            if (head)
+                return reverse(head);
+
+            // Park the consumer unless a producer has been faster.
+            Event* expected = 0;
+            if (m_head.compare_exchange_strong(expected, parkMarker(),
+                                               std::memory_order_acq_rel,
+                                               std::memory_order_relaxed))
+            {
+                m_consumerWakeup.wait();
+            }
+        }
+    }
+
+    //! Reverses a list of events.
+    static Event* reverse(Event* head)
+    {
+        Event* reversed = 0;
+        while (head)
+        {
+            Event* next = head->m_next;
+            head->m_next = reversed;
+            reversed = head;
+            head = next;
+        }
+        return reversed;
+    }
+};
+
+} // namespace uNet
+
+#endif // UNET_LOCKFREEEVENTLIST_HPP
@@ -132,11 +132,7 @@ void MemoryBusInterface::receive(const std::vector<uint8_t> &data)
 {
     std::cout << "[" << name() << "] receive - " << data.size() << std::endl;
     BufferBase* b = listener()->allocateBuffer();
-    for (std::size_t i = 0; i < data.size(); ++i)
-    {
-        uint8_t x = data[i];
-        b->push_back(x);
-    }
+    b->append(data.data(), data.size());
     listener()->notify(uNet::Event::createMessageReceiveEvent(this, b));
 }
 
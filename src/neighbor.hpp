@@ -6,6 +6,9 @@
 #include "buffer.hpp"
 #include "linklayeraddress.hpp"
 #include "networkaddress.hpp"
+#include "timerwheel.hpp"
+
+#include <boost/intrusive/list.hpp>
 
 namespace uNet
 {
@@ -26,7 +29,10 @@ class NetworkInterface;
 //! which have to be sent when the neighbor is known to be reachable. If
 //! the reachability cannot be determined within a certain time, the packets
 //! are dropped.
-class Neighbor
+//!
+//! The neighbor is also the timer which drives the transitions between the
+//! discovery states.
+class Neighbor : public Timer
 {
 public:
     //! An enumeration of discovery states.
@@ -38,6 +44,9 @@ public:
     //! - Stale: No response has been received from the neighbor for some
     //!   time and the reachability is questionable. Before sending a packet
     //!   to the neighbor, its reachability must be tested again.
+    //! - Delay: A packet has been sent to a stale neighbor. The kernel waits
+    //!   some time for a reachability confirmation from an upper layer
+    //!   before it starts probing.
     //! - Probe: The neighbor discovery is in progress. Further packets
     //!   addressed to this neighbor are delayed until after the neighbor
     //!   discovery.
@@ -46,6 +55,7 @@ public:
         Incomplete,
         Reachable,
         Stale,
+        Delay,
         Probe
     };
 
@@ -53,7 +63,7 @@ public:
     Neighbor()
         : m_state(Incomplete),
           m_interface(0),
-          m_neighborCacheHook(0)
+          m_numSolicitations(0)
     {
     }
 
@@ -75,6 +85,14 @@ public:
         return m_interface;
     }
 
+    //! Returns the number of solicitations.
+    //! Returns the number of neighbor solicitations which have been sent
+    //! since the discovery has been started.
+    unsigned numSolicitations() const
+    {
+        return m_numSolicitations;
+    }
+
     //! Returns the buffer queue.
     BufferQueue& sendQueue()
     {
@@ -101,6 +119,14 @@ public:
         m_linkLayerAddress = addr;
     }
 
+    //! Sets the number of solicitations.
+    //! Sets the number of neighbor solicitations which have been sent to
+    //! \p count.
+    void setNumSolicitations(unsigned count)
+    {
+        m_numSolicitations = count;
+    }
+
     //! Sets the discovery state.
     //! Sets the neighbor discovery state to \p state.
     void setState(DiscoveryState state)
@@ -123,13 +149,18 @@ private:
     NetworkInterface* m_interface;
     //! The link-layer address of the neighbor.
     LinkLayerAddress m_linkLayerAddress;
+    //! The number of solicitations which have been sent.
+    unsigned m_numSolicitations;
     //! A list of packets which have been delayed until after the neighbor
     //! discovery.
     BufferQueue m_delayedPackets;
 
 public:
-    //! The next neighbor in the cache.
-    Neighbor* m_neighborCacheHook;
+    typedef boost::intrusive::list_member_hook<
+        boost::intrusive::link_mode<boost::intrusive::normal_link> >
+        cache_hook_t;
+    //! A hook to put the neighbor in the LRU list of the neighbor cache.
+    cache_hook_t m_neighborCacheHook;
 };
 
 } // namespace uNet
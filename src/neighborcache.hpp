@@ -7,85 +7,200 @@
 
 #include <OperatingSystem/OperatingSystem.h>
 
+#include <boost/intrusive/list.hpp>
+
+#include <cstdint>
+
 namespace uNet
 {
 
+namespace detail
+{
+// Computes the number of bits of a hash index with at least 2 * N slots.
+template <unsigned N, unsigned TBits = 1,
+          bool TDone = ((1u << TBits) >= (2 * N))>
+struct hash_index_bits
+{
+    static const unsigned value = hash_index_bits<N, (TBits + 1)>::value;
+};
+
+template <unsigned N, unsigned TBits>
+struct hash_index_bits<N, TBits, true>
+{
+    static const unsigned value = TBits;
+};
+
+} // namespace detail
+
 //! The neighbor cache.
-//! The NeighborCache keeps track of the accessed neighbors.
+//! The NeighborCache keeps track of the accessed neighbors. The neighbors are
+//! allocated from a fixed-size pool. An open-addressing hash index maps a
+//! host address to its neighbor in constant time. The index has at least
+//! twice as many slots as there are neighbors such that the probe sequences
+//! stay short.
+//!
+//! In addition, the neighbors are kept in a list which is sorted by the time
+//! of their last use. When the pool is exhausted, the least recently used
+//! neighbor which is stale and has no pending packets is evicted to make
+//! room for a new entry.
 template <unsigned MaxNumNeighborsT>
 class NeighborCache
 {
+    static const unsigned indexBits
+        = detail::hash_index_bits<MaxNumNeighborsT>::value;
+    static const unsigned indexSize = 1u << indexBits;
+    static const unsigned indexMask = indexSize - 1;
+
 public:
     //! Creates a neighbor cache.
     NeighborCache()
-        : m_neighbors(0)
     {
+        for (unsigned idx = 0; idx < indexSize; ++idx)
+            m_index[idx] = 0;
     }
 
     //! Creates a new entry.
     //! Creates a new entry for a neighbor in this cache. The entry stores
     //! the neighbor's \p address and the interface \p ifc via which it
-    //! can be reached.
-    Neighbor* createEntry(HostAddress address, NetworkInterface* ifc)
+    //! can be reached. If the cache is full, the least recently used entry
+    //! which is stale and has an empty send queue is evicted. If there is no
+    //! such entry, a null-pointer is returned. If \p evicted is not a
+    //! null-pointer, it is set to \p true when an entry has been evicted.
+    Neighbor* createEntry(HostAddress address, NetworkInterface* ifc,
+                          bool* evicted = 0)
     {
+        UNET_ASSERT(find(address) == 0);
+
+        if (evicted)
+            *evicted = false;
         Neighbor* entry = m_neighborPool.construct();
+        if (!entry)
+        {
+            if (!evict())
+                return 0;
+            if (evicted)
+                *evicted = true;
+            entry = m_neighborPool.construct();
+            UNET_ASSERT(entry != 0);
+        }
+
         entry->setHostAddress(address);
         entry->setInterface(ifc);
-        entry->m_neighborCacheHook = m_neighbors;
-        m_neighbors = entry;
+        m_lruList.push_front(*entry);
+
+        unsigned idx = hash(address);
+        while (m_index[idx])
+            idx = (idx + 1) & indexMask;
+        m_index[idx] = entry;
         return entry;
     }
 
     //! Performs a lookup in the cache.
     //! Searches the neighbor with the given logical \p address in the neighbor
     //! cache and returns a pointer to it. If no matching neighbor has been
-    //! cached, a null-pointer is returned.
-    Neighbor* find(HostAddress address) const
+    //! cached, a null-pointer is returned. A neighbor which is found is
+    //! marked as the most recently used one.
+    Neighbor* find(HostAddress address)
     {
-        Neighbor* iter = m_neighbors;
-        while (iter)
+        for (unsigned idx = hash(address); m_index[idx];
+             idx = (idx + 1) & indexMask)
         {
-            if (iter->address() == address)
-                return iter;
-            iter = iter->m_neighborCacheHook;
+            Neighbor* entry = m_index[idx];
+            if (entry->address() == address)
+            {
+                m_lruList.splice(m_lruList.begin(), m_lruList,
+                                 m_lruList.iterator_to(*entry));
+                return entry;
+            }
         }
         return 0;
     }
 
-    // void update(HostAddress address);
+    //! Removes an entry.
+    //! Removes the \p entry from the cache and destroys it. The entry's
+    //! timer must not be active and its send queue must be empty.
+    void removeEntry(Neighbor* entry)
+    {
+        UNET_ASSERT(!entry->active());
+        UNET_ASSERT(entry->sendQueue().empty());
 
-private:
-    //! The first neighbor in the list.
-    Neighbor* m_neighbors;
+        unsigned idx = hash(entry->address());
+        while (m_index[idx] != entry)
+        {
+            UNET_ASSERT(m_index[idx] != 0);
+            idx = (idx + 1) & indexMask;
+        }
+        eraseFromIndex(idx);
+
+        m_lruList.erase(m_lruList.iterator_to(*entry));
+        m_neighborPool.destroy(entry);
+    }
 
+private:
     typedef OperatingSystem::object_pool<Neighbor, MaxNumNeighborsT>
         pool_t;
     //! The pool for the allocation of neighbors.
     pool_t m_neighborPool;
-};
 
-#if 0
-// - lookupDestination() Called from the kernel if it wants to send a
-//   packet to a destination.
-class NextHopCache
-{
-public:
-    Neighbor* lookupDestination(HostAddress address) const;
-    Neighbor* lookupNeighbor(HostAddress address) const;
-    Neighbor* createNeighborCacheEntry(HostAddress address,
-                                       NetworkInterface* interface);
-    void removeNeighborCacheEntry();
+    //! The hash index which maps host addresses to neighbors.
+    Neighbor* m_index[indexSize];
 
-private:
-    typedef std::map<HostAddress, const Neighbor*> AddressToHopInfoMap;
-    typedef std::list<Neighbor*> NeighborCacheVector;
+    typedef boost::intrusive::list<
+            Neighbor,
+            boost::intrusive::member_hook<
+                Neighbor,
+                Neighbor::cache_hook_t,
+                &Neighbor::m_neighborCacheHook>,
+            boost::intrusive::constant_time_size<false> > lru_list_t;
+    //! The neighbors sorted from the most to the least recently used one.
+    lru_list_t m_lruList;
 
-    AddressToHopInfoMap m_destinationCache;  // TODO: use a sorted list
-    NeighborCacheVector m_neighborCache; // TODO: use a StaticObjectPool
+    //! Returns the home slot of an address in the hash index.
+    static unsigned hash(HostAddress address)
+    {
+        // Fibonacci hashing spreads consecutive addresses over the index.
+        return (std::uint32_t(address.address()) * 2654435769u)
+               >> (32 - indexBits);
+    }
 
-    StaticObjectPool<Neighbor, MAX_NUM_NEIGHBORS> m_neighborPool;
+    //! Clears a slot in the hash index.
+    //! Clears the slot \p idx and shifts the following entries of the
+    //! probe sequence backwards such that no tombstones are needed.
+    void eraseFromIndex(unsigned idx)
+    {
+        m_index[idx] = 0;
+        for (unsigned next = (idx + 1) & indexMask; m_index[next];
+             next = (next + 1) & indexMask)
+        {
+            // The entry can be moved into the hole unless its home slot
+            // lies cyclically between the hole and its current position.
+            unsigned home = hash(m_index[next]->address());
+            if (((next - home) & indexMask) >= ((next - idx) & indexMask))
+            {
+                m_index[idx] = m_index[next];
+                m_index[next] = 0;
+                idx = next;
+            }
+        }
+    }
+
+    //! Evicts the least recently used neighbor which is stale and has no
+    //! pending packets. Returns \p true, if a neighbor has been evicted.
+    bool evict()
+    {
+        for (typename lru_list_t::reverse_iterator iter = m_lruList.rbegin();
+             iter != m_lruList.rend(); ++iter)
+        {
+            if (   iter->state() == Neighbor::Stale
+                && iter->sendQueue().empty())
+            {
+                removeEntry(&*iter);
+                return true;
+            }
+        }
+        return false;
+    }
 };
-#endif
 
 } // namespace uNet
 
@@ -113,6 +113,39 @@ neighbor solicitation. If the advertisment is sent unsolicited, it is the
 address of the interface which changed its link-layer address.
 
 
+Congestion notification message
+
+A congestion notification is sent by a device which has dropped a packet
+because the receive queue of the destination port was full. It asks the
+sender to slow down.
+
+\code
+0                   1                   2                   3
+0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
++-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+|     Type      |     Code      |           Checksum            |
++---------------+---------------+---------------+---------------+
+|  Next header  |     Port      |           reserved            |
++---------------+---------------+---------------+---------------+
+\endcode
+
+Network protocol fields:
+    Source address
+            The address of the interface via which the notification is sent.
+
+    Destination address
+            The source address of the dropped packet.
+
+NCP fields:
+    Type    3
+    Code    0
+
+The <tt>Next header</tt> is the protocol of the dropped packet and \p Port is
+the port from which it has been sent. Thus, the sender can pass the
+notification on to the socket which has sent the packet. In contrast to the
+neighbor discovery messages, a congestion notification may be routed.
+
+
 NCP options
 
 NCP options can be appended to an NCP message. Every NCP option starts with
@@ -191,6 +224,7 @@ NCP option fields
 
 #include "protocol/protocol.hpp"
 
+#include <atomic>
 #include <cstring>
 #include <cstdint>
 
@@ -242,6 +276,24 @@ struct NeighborAdvertisment
     std::uint16_t reserved : 15;
 };
 
+struct CongestionNotification
+{
+    static const int ncpType = 3;
+
+    CongestionNotification()
+        : header(3),
+          nextHeader(0),
+          port(0),
+          reserved(0)
+    {
+    }
+
+    NetworkControlProtocolHeader header;
+    std::uint8_t nextHeader;
+    std::uint8_t port;
+    std::uint16_t reserved;
+};
+
 namespace NcpOption
 {
 
@@ -340,6 +392,16 @@ public:
     {
     }
 
+    //! Creates a congestion notification message.
+    void createCongestionNotification(std::uint8_t nextHeader,
+                                      std::uint8_t port)
+    {
+        CongestionNotification notification;
+        notification.nextHeader = nextHeader;
+        notification.port = port;
+        m_buffer.push_back(notification);
+    }
+
     //! Creates a neighbor advertisment message.
     void createNeighborAdvertisment(HostAddress targetAddress,
                                     bool solicited = false)
@@ -381,6 +443,18 @@ template <typename KernelT>
 class NcpHandler
 {
 public:
+    NcpHandler()
+        : m_numCongestionNotifications(0)
+    {
+    }
+
+    //! Returns the number of congestion notifications which have been
+    //! received.
+    unsigned numReceivedCongestionNotifications() const
+    {
+        return m_numCongestionNotifications.load(std::memory_order_relaxed);
+    }
+
     //! Handles a network control protocol message.
     //! Handles an incoming NCP message with its associated network protocol
     //! \p metaData. The NCP payload is passed in the \p packet buffer.
@@ -388,11 +462,10 @@ public:
     {
         // Perform some sanity checks.
         // - The packet is large enough
-        // - The packet must not have been routed (HopCnt is the maximum
-        //   possible value).
+        // - A neighbor discovery message must not have been routed (HopCnt
+        //   is the maximum possible value).
         //! \todo Compare the checksum
-        if (   packet.size() < sizeof(NetworkControlProtocolHeader)
-            || metaData.npHeader.hopCount != NetworkProtocolHeader::maxHopCount)
+        if (packet.size() < sizeof(NetworkControlProtocolHeader))
         {
             // diagnostics.corruptHeader(packet.data());
             packet.dispose();
@@ -402,8 +475,19 @@ public:
         const NetworkControlProtocolHeader header
                 = packet.copy_front<NetworkControlProtocolHeader>();
 
+        if (   (   header.type == NeighborSolicitation::ncpType
+                || header.type == NeighborAdvertisment::ncpType)
+            && metaData.npHeader.hopCount != NetworkProtocolHeader::maxHopCount)
+        {
+            packet.dispose();
+            return;
+        }
+
         switch (header.type)
         {
+            case CongestionNotification::ncpType:
+                onNcpCongestionNotification(metaData, packet);
+                break;
             case NeighborSolicitation::ncpType:
                 derived()->onNcpNeighborSolicitation(metaData, packet);
                 break;
@@ -418,6 +502,30 @@ public:
     }
 
 private:
+    //! The number of received congestion notifications.
+    std::atomic<unsigned> m_numCongestionNotifications;
+
+    //! Handles a congestion notification.
+    //! The notification is counted and passed on to the protocol handler
+    //! of the dropped packet, which informs the sending socket.
+    void onNcpCongestionNotification(const ProtocolMetaData& metaData,
+                                     BufferBase& packet)
+    {
+        if (packet.size() < sizeof(CongestionNotification))
+        {
+            packet.dispose();
+            return;
+        }
+
+        CongestionNotification notification
+                = packet.copy_front<CongestionNotification>();
+        packet.dispose();
+        m_numCongestionNotifications.fetch_add(1, std::memory_order_relaxed);
+        derived()->receiveCongestionNotification(
+                    metaData.npHeader.sourceAddress, notification.nextHeader,
+                    notification.port);
+    }
+
     //! Handle a neighbor solicitation.
     //! This method is called upon receiving a neighbor solicitation. The
     //! network protocol's meta data is passed in \p metaData and the \p packet
@@ -463,7 +571,7 @@ private:
                                      metaData.npHeader.sourceAddress);
             if (!neighbor)
             {
-                neighbor = derived()->nc.createEntry(
+                neighbor = derived()->createNeighbor(
                                metaData.npHeader.sourceAddress,
                                metaData.networkInterface);
                 if (neighbor)
@@ -477,6 +585,10 @@ private:
                 {
                     sourceLinkLayerAddress = srcLla->linkLayerAddress();
                     neighbor->setLinkLayerAddress(sourceLinkLayerAddress);
+
+                    // The solicitation completes a pending discovery.
+                    if (neighbor->state() == Neighbor::Incomplete)
+                        derived()->setNeighborStale(*neighbor);
                 }
             }
         }
@@ -536,25 +648,26 @@ private:
             return;
         }
 
-        //! \todo Should be stale?
-        neighbor->setState(Neighbor::Reachable);
-
-        if (NcpOption::TargetLinkLayerAddress* targetLla
-            = NcpOption::find<NcpOption::TargetLinkLayerAddress>(
-                packet.begin(), packet.end()))
-        {
+        NcpOption::TargetLinkLayerAddress* targetLla
+                = NcpOption::find<NcpOption::TargetLinkLayerAddress>(
+                      packet.begin(), packet.end());
+        if (targetLla)
             neighbor->setLinkLayerAddress(targetLla->linkLayerAddress());
-        }
 
         packet.dispose();
 
-        // Send all packets which have been queued until the reachability
-        // could be confirmed.
-        while (!neighbor->sendQueue().empty())
+        // A solicited advertisment confirms the reachability. An unsolicited
+        // one only tells us the link-layer address. In both cases, the
+        // packets which have been queued for the neighbor are sent.
+        if (advertisment.solicited)
+        {
+            derived()->setNeighborReachable(*neighbor);
+        }
+        else if (   neighbor->state() == Neighbor::Incomplete
+                 && (   targetLla
+                     || !metaData.networkInterface->linkHasAddresses()))
         {
-            BufferBase& buffer = neighbor->sendQueue().front();
-            neighbor->sendQueue().pop_front();
-            derived()->notify(Event::createMessageSendEvent(&buffer));
+            derived()->setNeighborStale(*neighbor);
         }
     }
 
@@ -40,6 +40,11 @@ void NetworkInterface::setNetworkAddress(const NetworkAddress &addr)
     m_networkAddress = addr;
 }
 
+bool NetworkInterface::supportsGather() const
+{
+    return false;
+}
+
 void NetworkInterface::setListener(NetworkInterfaceListener* listener)
 {
     m_listener = listener;
@@ -69,6 +69,8 @@ public:
     //! Sends a broadcast.
     //! Broadcasts the \p packet to all interfaces on the link.
     //! \note After sending the \p packet, the buffer has to be disposed.
+    //! \note The \p packet may be shared with other interfaces and must not
+    //! be modified.
     //! \note This function must be thread-safe.
     virtual void broadcast(BufferBase& packet) = 0;
 
@@ -136,6 +138,14 @@ public:
     //! Attaches the given \p listener to this network interface.
     void setListener(NetworkInterfaceListener* listener);
 
+    //! Checks if the interface can send chained packets.
+    //! Returns \p true, if the interface is able to send a packet which is
+    //! stored in a chain of buffers (see BufferBase::nextSegment()). Such an
+    //! interface has to gather the data from all segments when sending the
+    //! packet. Chained packets are never passed to an interface which does
+    //! not support gathering. The default implementation returns \p false.
+    virtual bool supportsGather() const;
+
 private:
     //! The link-layer address of this interface.
     LinkLayerAddress m_linkLayerAddress;
@@ -6,32 +6,252 @@
 #include "protocol.hpp"
 
 #include <boost/mpl/fold.hpp>
+#include <boost/mpl/max.hpp>
+#include <boost/mpl/size_t.hpp>
 #include <boost/mpl/vector.hpp>
 
+#include <cstddef>
 #include <cstdint>
 
 namespace uNet
 {
 class KernelBase;
 
+namespace detail
+{
+
+// Checks if a protocol handler declares a static headerType.
+template <typename THandler>
+struct has_header_type
+{
+    template <int TValue>
+    struct value_holder;
+
+    template <typename T>
+    static char test(value_holder<T::headerType>*);
+
+    template <typename T>
+    static long test(...);
+
+    static const bool value = sizeof(test<THandler>(0)) == sizeof(char);
+};
+
+// Checks if a protocol handler accepts congestion notifications.
+template <typename THandler>
+struct has_congestion_handler
+{
+    template <typename T, void (T::*)(HostAddress, std::uint8_t)>
+    struct member_holder;
+
+    template <typename T>
+    static char test(member_holder<T,
+                                   &T::receiveCongestionNotification>*);
+
+    template <typename T>
+    static long test(...);
+
+    static const bool value = sizeof(test<THandler>(0)) == sizeof(char);
+};
+
+// A table which maps the header type of an incoming packet to the handler
+// which receives it. The table stores a byte per header type, which is
+// either zero or the index of a receive function plus one.
+template <typename TChain>
+struct ProtocolDispatchTable
+{
+    typedef void (*receive_function)(TChain& chain,
+                                     const ProtocolMetaData& metaData,
+                                     BufferBase& packet);
+
+    ProtocolDispatchTable()
+        : m_numHandlers(0)
+    {
+        for (unsigned idx = 0; idx < 256; ++idx)
+            m_handlerIndex[idx] = 0;
+    }
+
+    // Adds a handler unless the header type has been claimed by a handler
+    // which has been added before.
+    void add(std::uint8_t headerType, receive_function receive)
+    {
+        if (m_handlerIndex[headerType])
+            return;
+        m_receive[m_numHandlers] = receive;
+        m_handlerIndex[headerType] = ++m_numHandlers;
+    }
+
+    //! The index of the handler plus one for every header type.
+    std::uint8_t m_handlerIndex[256];
+    //! The receive functions of the handlers.
+    receive_function m_receive[TChain::num_handlers > 0
+                               ? TChain::num_handlers : 1];
+    //! The number of handlers in the table.
+    std::uint8_t m_numHandlers;
+};
+
+template <typename THandler, bool THasHeaderType>
+struct protocol_dispatch_helper;
+
+// A handler with a header type is entered into the dispatch table. On the
+// linear path, the header type is compared instead of calling filter().
+template <typename THandler>
+struct protocol_dispatch_helper<THandler, true>
+{
+    static const bool has_header_type = true;
+
+    template <typename TChain>
+    static void addTo(ProtocolDispatchTable<TChain>& table)
+    {
+        table.add(THandler::headerType, &receive<TChain>);
+    }
+
+    static bool filter(const THandler& /*handler*/,
+                       const ProtocolMetaData& metaData)
+    {
+        return metaData.npHeader.nextHeader == THandler::headerType;
+    }
+
+    template <typename TChain>
+    static void receive(TChain& chain, const ProtocolMetaData& metaData,
+                        BufferBase& packet)
+    {
+        static_cast<THandler&>(chain).receive(metaData, packet);
+    }
+};
+
+// A handler without a header type is asked via its filter() method.
+template <typename THandler>
+struct protocol_dispatch_helper<THandler, false>
+{
+    static const bool has_header_type = false;
+
+    template <typename TChain>
+    static void addTo(ProtocolDispatchTable<TChain>& /*table*/)
+    {
+    }
+
+    static bool filter(const THandler& handler,
+                       const ProtocolMetaData& metaData)
+    {
+        return handler.filter(metaData);
+    }
+};
+
+template <typename THandler, bool TAcceptsNotification>
+struct congestion_dispatch_helper
+{
+    static bool notify(THandler& /*handler*/, HostAddress /*source*/,
+                       std::uint8_t /*headerType*/, std::uint8_t /*port*/)
+    {
+        return false;
+    }
+};
+
+// A handler with a header type and a receiveCongestionNotification() method
+// receives the notifications for its header type.
+template <typename THandler>
+struct congestion_dispatch_helper<THandler, true>
+{
+    static bool notify(THandler& handler, HostAddress source,
+                       std::uint8_t headerType, std::uint8_t port)
+    {
+        if (headerType != THandler::headerType)
+            return false;
+        handler.receiveCongestionNotification(source, port);
+        return true;
+    }
+};
+
+} // namespace detail
+
 //! A class for chaining protocol handlers.
 //! The ProtocolHandlerChain inherits a protocol handler and a base chain.
+//!
+//! A handler which only accepts packets with a certain next header type
+//! should declare this type in a static constant \p headerType. Its filter()
+//! method is not called. All other handlers are asked one after the other
+//! whether they accept a packet.
+//!
+//! The order of the chain decides which handler receives a packet. The
+//! handlers with a header type which come before the first handler without
+//! one are looked up in a table, which is indexed with the next header
+//! field of the network protocol header. A handler with a header type which
+//! comes later is found on the linear path, such that it never takes a
+//! packet away from a preceding handler without a header type.
 template <typename THandler, typename TBaseChain>
 class ProtocolHandlerChain : public THandler, public TBaseChain
 {
+    typedef detail::protocol_dispatch_helper<
+                THandler,
+                detail::has_header_type<THandler>::value> helper_t;
+    typedef detail::congestion_dispatch_helper<
+                THandler,
+                detail::has_header_type<THandler>::value
+                && detail::has_congestion_handler<THandler>::value>
+            congestion_helper_t;
+
 public:
+    //! The number of handlers in the chain excluding the custom handler.
+    static const unsigned num_handlers = TBaseChain::num_handlers + 1;
+
     //! Dispatches an incoming packet.
     //! Dispatches the incoming \p packet with an associated network protocol
-    //! \p metaData. If the protocol handler \p THandler accepts the packet
-    //! (\p filter() returns \p true), the packet is passed on to it.
-    //! Otherwise, the dispatch() method inherited from the base chain is
-    //! called.
+    //! \p metaData. The packet is passed on to the first handler in the
+    //! chain which accepts it and finally to the custom protocol handler.
+    //! If this is a handler in the dispatch table, it is found in constant
+    //! time.
     void dispatch(const ProtocolMetaData& metaData, BufferBase& packet)
     {
-        if (THandler::filter(metaData))
+        static const detail::ProtocolDispatchTable<ProtocolHandlerChain>
+                table = createDispatchTable();
+
+        std::uint8_t index
+                = table.m_handlerIndex[metaData.npHeader.nextHeader];
+        if (index)
+            table.m_receive[index - 1](*this, metaData, packet);
+        else
+            filterAndDispatch(metaData, packet);
+    }
+
+    //! Dispatches an incoming packet to the first handler which accepts it
+    //! without consulting the dispatch table.
+    void filterAndDispatch(const ProtocolMetaData& metaData,
+                           BufferBase& packet)
+    {
+        if (helper_t::filter(*this, metaData))
             THandler::receive(metaData, packet);
         else
-            TBaseChain::dispatch(metaData, packet);
+            TBaseChain::filterAndDispatch(metaData, packet);
+    }
+
+    //! Dispatches a congestion notification.
+    //! Passes a congestion notification, which has been received from the
+    //! \p source, to the handler of the \p headerType. The \p port is the
+    //! protocol's port from which the dropped packet has been sent. If the
+    //! handler has no method receiveCongestionNotification(), the
+    //! notification is ignored.
+    void dispatchCongestionNotification(HostAddress source,
+                                        std::uint8_t headerType,
+                                        std::uint8_t port)
+    {
+        if (!congestion_helper_t::notify(*this, source, headerType, port))
+        {
+            TBaseChain::dispatchCongestionNotification(source, headerType,
+                                                       port);
+        }
+    }
+
+    //! Adds the handlers with a header type to the dispatch \p table of
+    //! the chain \p TChain up to the first handler without a header type.
+    template <typename TChain>
+    static void addToDispatchTable(detail::ProtocolDispatchTable<TChain>& table)
+    {
+        // A handler without a header type might accept any packet. The
+        // handlers behind it must not be preferred over it.
+        if (!helper_t::has_header_type)
+            return;
+        helper_t::addTo(table);
+        TBaseChain::addToDispatchTable(table);
     }
 
     //! Returns a pointer to a handler in this chain.
@@ -53,12 +273,23 @@ public:
         THandler::setKernel(kernel);
         TBaseChain::setKernel(kernel);
     }
+
+private:
+    static detail::ProtocolDispatchTable<ProtocolHandlerChain>
+    createDispatchTable()
+    {
+        detail::ProtocolDispatchTable<ProtocolHandlerChain> table;
+        addToDispatchTable(table);
+        return table;
+    }
 };
 
 template <>
 class ProtocolHandlerChain<void, void>
 {
 public:
+    static const unsigned num_handlers = 0;
+
     ProtocolHandlerChain()
         : m_customHandler(0)
     {
@@ -70,6 +301,20 @@ public:
     //! If a custom protocol handler has been set and it accepts the \p header,
     //! the packet is passed on to it. Otherwise, the packet is disposed.
     void dispatch(const ProtocolMetaData& metaData, BufferBase& packet)
+    {
+        filterAndDispatch(metaData, packet);
+    }
+
+    //! Ignores a congestion notification which nobody handles.
+    void dispatchCongestionNotification(HostAddress /*source*/,
+                                        std::uint8_t /*headerType*/,
+                                        std::uint8_t /*port*/)
+    {
+    }
+
+    //! Dispatches an incoming packet to the custom protocol handler.
+    void filterAndDispatch(const ProtocolMetaData& metaData,
+                           BufferBase& packet)
     {
         if (m_customHandler && m_customHandler->filter(metaData))
             m_customHandler->receive(metaData, packet);
@@ -108,6 +353,12 @@ public:
         m_customHandler = handler;
     }
 
+    template <typename TChain>
+    static void addToDispatchTable(
+            detail::ProtocolDispatchTable<TChain>& /*table*/)
+    {
+    }
+
     void setKernel(KernelBase* /*kernel*/)
     {
     }
@@ -134,6 +385,18 @@ struct make_protocol_handler_chain_helper
     };
 };
 
+struct max_protocol_header_size_helper
+{
+    template <typename T1, typename T2>
+    struct apply
+    {
+        typedef typename boost::mpl::max<
+                             T1,
+                             boost::mpl::size_t<T2::max_header_size> >::type
+            type;
+    };
+};
+
 } // namespace detail
 
 //! \code
@@ -150,6 +413,20 @@ struct make_protocol_handler_chain
 
 };
 
+//! Computes the maximum header size of a list of protocols.
+//! Every protocol handler in \p THandlerTypes has to specify the size of
+//! the headers which it prepends to a packet in a static constant
+//! \p max_header_size. The \p value is the maximum of these sizes.
+template <typename THandlerTypes>
+struct max_protocol_header_size
+{
+    static const std::size_t value
+        = boost::mpl::fold<
+              THandlerTypes,
+              boost::mpl::size_t<0>,
+              detail::max_protocol_header_size_helper>::type::value;
+};
+
 } // namespace uNet
 
 #endif // UNET_PROTOCOLHANDLERCHAIN_HPP
@@ -29,32 +29,185 @@ void ReceiveConnection::close()
     }
 }
 
+unsigned ReceiveConnection::numDropped() const
+{
+    if (!m_descriptor)
+        ::uNet::throw_exception(-1); //! \todo system_error
+
+    OperatingSystem::lock_guard<OperatingSystem::mutex> queueLock(
+                m_descriptor->m_mutex);
+    return m_descriptor->m_numDropped;
+}
+
+BufferBase* ReceiveConnection::try_receive()
+{
+    if (!m_descriptor)
+        ::uNet::throw_exception(-1); //! \todo system_error
+
+    if (!m_descriptor->m_packetSemaphore.try_wait())
+        return 0;
+    return dequeue();
+}
+
 BufferBase* ReceiveConnection::receive()
 {
     if (!m_descriptor)
         ::uNet::throw_exception(-1); //! \todo system_error
 
     m_descriptor->m_packetSemaphore.wait();
+    return dequeue();
+}
+
+// -----------------------------------------------------------------------------
+// Private methods
+// -----------------------------------------------------------------------------
+
+BufferBase* ReceiveConnection::dequeue()
+{
     OperatingSystem::lock_guard<OperatingSystem::mutex> queueLock(
                 m_descriptor->m_mutex);
     if (m_descriptor->m_packetQueue.empty())
         return 0;
-    else
+
+    BufferBase& buffer = m_descriptor->m_packetQueue.front();
+    m_descriptor->m_packetQueue.pop_front();
+    --m_descriptor->m_queueLength;
+    m_descriptor->m_receiveSocket.m_numQueued.fetch_sub(1);
+    return &buffer;
+}
+
+// ----=====================================================================----
+//     Poller
+// ----=====================================================================----
+
+Poller::Poller()
+    : m_numConnections(0),
+      m_nonEmpty(0)
+{
+}
+
+Poller::~Poller()
+{
+    UNET_ASSERT(m_numConnections == 0);
+}
+
+void Poller::add(ReceiveConnection& connection)
+{
+    detail::ReceiveConnectionDescriptor* descriptor = connection.m_descriptor;
+    if (!descriptor)
+        ::uNet::throw_exception(-1); //! \todo system_error
+
+    OperatingSystem::lock_guard<OperatingSystem::mutex> queueLock(
+                descriptor->m_mutex);
+    if (descriptor->m_poller)
+        ::uNet::throw_exception(-1); //! \todo system_error
+
+    descriptor->m_poller = this;
+    descriptor->m_connection = &connection;
     {
-        BufferBase& buffer = m_descriptor->m_packetQueue.front();
-        m_descriptor->m_packetQueue.pop_front();
-        return &buffer;
+        OperatingSystem::lock_guard<OperatingSystem::mutex> lock(m_mutex);
+        ++m_numConnections;
     }
+    if (descriptor->m_queueLength)
+        setReady(*descriptor);
+}
+
+std::size_t Poller::size() const
+{
+    OperatingSystem::lock_guard<OperatingSystem::mutex> lock(m_mutex);
+    return m_numConnections;
+}
+
+void Poller::remove(ReceiveConnection& connection)
+{
+    detail::ReceiveConnectionDescriptor* descriptor = connection.m_descriptor;
+    if (!descriptor)
+        return;
+
+    OperatingSystem::lock_guard<OperatingSystem::mutex> queueLock(
+                descriptor->m_mutex);
+    if (descriptor->m_poller == this)
+        detach(*descriptor);
+}
+
+ReceiveConnection* Poller::wait()
+{
+    for (;;)
+    {
+        m_nonEmpty.wait();
+        if (ReceiveConnection* connection = popReady())
+            return connection;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Private methods
+// -----------------------------------------------------------------------------
+
+void Poller::detach(detail::ReceiveConnectionDescriptor& descriptor)
+{
+    OperatingSystem::lock_guard<OperatingSystem::mutex> lock(m_mutex);
+    if (descriptor.m_ready)
+    {
+        m_readyList.erase(m_readyList.iterator_to(descriptor));
+        descriptor.m_ready = false;
+    }
+    descriptor.m_poller = 0;
+    descriptor.m_connection = 0;
+    --m_numConnections;
+}
+
+ReceiveConnection* Poller::popReady()
+{
+    OperatingSystem::lock_guard<OperatingSystem::mutex> lock(m_mutex);
+    // A connection which has been removed in the meantime leaves a surplus
+    // post of the semaphore behind.
+    if (m_readyList.empty())
+        return 0;
+
+    detail::ReceiveConnectionDescriptor& descriptor = m_readyList.front();
+    m_readyList.pop_front();
+    descriptor.m_ready = false;
+    if (!m_readyList.empty())
+        m_nonEmpty.post();
+    return descriptor.m_connection;
+}
+
+void Poller::setReady(detail::ReceiveConnectionDescriptor& descriptor)
+{
+    OperatingSystem::lock_guard<OperatingSystem::mutex> lock(m_mutex);
+    if (descriptor.m_ready)
+        return;
+
+    descriptor.m_ready = true;
+    if (m_readyList.empty())
+        m_nonEmpty.post();
+    m_readyList.push_back(descriptor);
 }
 
 // ----=====================================================================----
 //     ReceiveSocketBase
 // ----=====================================================================----
 
+// Combines the source address and the source port of a packet into an
+// identifier of its flow.
+static std::uint32_t flowIdentifier(HostAddress sourceAddress,
+                                    std::uint8_t sourcePort)
+{
+    return (std::uint32_t(sourceAddress.address()) << 8) | sourcePort;
+}
+
 ReceiveSocketBase::ReceiveSocketBase(SimpleMessageProtocol& protocolHandler,
                                      std::uint8_t localPort)
     : m_protocolHandler(protocolHandler),
-      m_localPort(localPort)
+      m_localPort(localPort),
+      m_deliveryPolicy(FlowHash),
+      m_overflowPolicy(DropNewest),
+      m_maxConnectionQueueLength(0),
+      m_maxSocketQueueLength(0),
+      m_numQueued(0),
+      m_numDropped(0),
+      m_numCongestionNotifications(0)
 {
     m_protocolHandler.addReceiveSocket(*this);
 }
@@ -80,34 +233,127 @@ void ReceiveSocketBase::close(detail::ReceiveConnectionDescriptor* descriptor)
 {
     OperatingSystem::lock_guard<OperatingSystem::mutex> listLock(m_mutex);
     m_descriptors.erase(m_descriptors.iterator_to(*descriptor));
+
+    if (descriptor->m_poller)
+    {
+        OperatingSystem::lock_guard<OperatingSystem::mutex> queueLock(
+                    descriptor->m_mutex);
+        descriptor->m_poller->detach(*descriptor);
+    }
+
+    // Dispose the packets which have not been received.
+    while (!descriptor->m_packetQueue.empty())
+    {
+        BufferBase& buffer = descriptor->m_packetQueue.front();
+        descriptor->m_packetQueue.pop_front();
+        buffer.dispose();
+    }
+    m_numQueued.fetch_sub(descriptor->m_queueLength);
     releaseDescriptor(descriptor);
 }
 
+ReceiveSocketStatistics ReceiveSocketBase::statistics() const
+{
+    OperatingSystem::lock_guard<OperatingSystem::mutex> listLock(m_mutex);
+    ReceiveSocketStatistics stats;
+    stats.numQueued = m_numQueued;
+    stats.numDropped = m_numDropped;
+    stats.numCongestionNotifications = m_numCongestionNotifications;
+    return stats;
+}
+
 // -----------------------------------------------------------------------------
 // Private methods
 // -----------------------------------------------------------------------------
 
-bool ReceiveSocketBase::filterPacket(std::uint8_t destinationPort,
-                                     BufferBase& packet)
+void ReceiveSocketBase::deliver(HostAddress sourceAddress,
+                                std::uint8_t sourcePort, BufferBase& packet)
 {
-    if (m_localPort != destinationPort)
-        return false;
-
     OperatingSystem::lock_guard<OperatingSystem::mutex> listLock(m_mutex);
+    if (m_descriptors.empty())
+    {
+        packet.dispose();
+        return;
+    }
 
-    for (descriptor_list_t::iterator iter = m_descriptors.begin(),
-                                 end_iter = m_descriptors.end();
-         iter != end_iter; ++iter)
+    descriptor_list_t::iterator iter = m_descriptors.begin();
+    if (m_deliveryPolicy == RoundRobin)
     {
-        OperatingSystem::lock_guard<OperatingSystem::mutex> queueLock(
-                    iter->m_mutex);
-        iter->m_packetQueue.push_back(packet);
-        iter->m_packetSemaphore.post();
-        return true;
+        // Move the selected connection to the back of the list such that
+        // the next packet is delivered to the following one.
+        if (m_descriptors.size() > 1)
+        {
+            detail::ReceiveConnectionDescriptor& descriptor
+                    = m_descriptors.front();
+            m_descriptors.pop_front();
+            m_descriptors.push_back(descriptor);
+            iter = m_descriptors.iterator_to(descriptor);
+        }
     }
+    else
+    {
+        // Fibonacci hashing of the flow identifier.
+        std::uint32_t hash = flowIdentifier(sourceAddress, sourcePort)
+                             * 2654435769u;
+        std::size_t index = (std::uint64_t(hash) * m_descriptors.size()) >> 32;
+        for (; index; --index)
+            ++iter;
+    }
+
+    OperatingSystem::lock_guard<OperatingSystem::mutex> queueLock(
+                iter->m_mutex);
+    if (   (   m_maxConnectionQueueLength
+            && iter->m_queueLength >= m_maxConnectionQueueLength)
+        || (m_maxSocketQueueLength && m_numQueued >= m_maxSocketQueueLength))
+    {
+        ++iter->m_numDropped;
+        ++m_numDropped;
 
-    packet.dispose();
-    return true;
+        if (m_overflowPolicy == DropOldest && iter->m_queueLength)
+        {
+            // Replace the oldest packet. The length of the queue does not
+            // change.
+            BufferBase& oldest = iter->m_packetQueue.front();
+            iter->m_packetQueue.pop_front();
+            iter->m_packetQueue.push_back(packet);
+            oldest.dispose();
+            return;
+        }
+
+        packet.dispose();
+        if (m_overflowPolicy == Backpressure)
+            notifyCongestion(*iter, sourceAddress, sourcePort);
+        return;
+    }
+
+    iter->m_numCongestedFlows = 0;
+    iter->m_packetQueue.push_back(packet);
+    ++iter->m_queueLength;
+    m_numQueued.fetch_add(1);
+    iter->m_packetSemaphore.post();
+    if (iter->m_queueLength == 1 && iter->m_poller)
+        iter->m_poller->setReady(*iter);
+}
+
+void ReceiveSocketBase::notifyCongestion(
+        detail::ReceiveConnectionDescriptor& descriptor,
+        HostAddress sourceAddress, std::uint8_t sourcePort)
+{
+    // Every flow is notified only once until the connection accepts a
+    // packet again. If too many flows are congested, the ones which do not
+    // fit into the list are notified about every dropped packet.
+    std::uint32_t flow = flowIdentifier(sourceAddress, sourcePort);
+    for (unsigned idx = 0; idx < descriptor.m_numCongestedFlows; ++idx)
+        if (descriptor.m_congestedFlows[idx] == flow)
+            return;
+    if (   descriptor.m_numCongestedFlows
+        < detail::ReceiveConnectionDescriptor::maxNumCongestedFlows)
+    {
+        descriptor.m_congestedFlows[descriptor.m_numCongestedFlows++] = flow;
+    }
+
+    ++m_numCongestionNotifications;
+    m_protocolHandler.sendCongestionNotification(sourceAddress, sourcePort);
 }
 
 // ----=====================================================================----
@@ -135,8 +381,26 @@ void SendConnection::send(BufferBase* packet)
 SendSocket::SendSocket(SimpleMessageProtocol &protocolHandler,
                        std::uint8_t localPort)
     : m_protocolHandler(protocolHandler),
-      m_localPort(localPort)
+      m_localPort(localPort),
+      m_congested(false),
+      m_numCongestionNotifications(0)
 {
+    m_protocolHandler.addSendSocket(*this);
+}
+
+SendSocket::~SendSocket()
+{
+    m_protocolHandler.removeSendSocket(*this);
+}
+
+void SendSocket::clearCongestion()
+{
+    m_congested = false;
+}
+
+bool SendSocket::congested() const
+{
+    return m_congested;
 }
 
 SendConnection SendSocket::connect(HostAddress destinationAddress,
@@ -145,6 +409,11 @@ SendConnection SendSocket::connect(HostAddress destinationAddress,
     return SendConnection(*this, destinationAddress, destinationPort);
 }
 
+unsigned SendSocket::numCongestionNotifications() const
+{
+    return m_numCongestionNotifications;
+}
+
 void SendSocket::send(SendConnection &con, BufferBase *packet)
 {
     m_protocolHandler.send(
@@ -152,54 +421,81 @@ void SendSocket::send(SendConnection &con, BufferBase *packet)
                 con.m_destinationPort, *packet);
 }
 
+// -----------------------------------------------------------------------------
+// Private methods
+// -----------------------------------------------------------------------------
+
+void SendSocket::notifyCongestion()
+{
+    ++m_numCongestionNotifications;
+    m_congested = true;
+}
+
 // ----=====================================================================----
 //     SimpleMessageProtocol
 // ----=====================================================================----
 
 void SimpleMessageProtocol::addReceiveSocket(ReceiveSocketBase& socket)
 {
-    OperatingSystem::lock_guard<OperatingSystem::mutex> lock(m_socketMutex);
-
-    if (m_receiveSockets.empty())
+    // No two sockets can bind to the same local port.
+    ReceiveSocketBase* expected = 0;
+    if (!m_receiveSockets[socket.localPort()].compare_exchange_strong(
+            expected, &socket))
     {
-        m_receiveSockets.push_front(socket);
-        return;
+        ::uNet::throw_exception(-1); // system_error
     }
+}
 
-    receiver_socket_list_t::iterator prev_iter = m_receiveSockets.end();
-    for (receiver_socket_list_t::iterator iter = m_receiveSockets.begin(),
-                                      end_iter = m_receiveSockets.end();
-         iter != end_iter; ++iter)
+void SimpleMessageProtocol::removeReceiveSocket(ReceiveSocketBase& socket)
+{
+    UNET_ASSERT(m_receiveSockets[socket.localPort()] == &socket);
+    m_receiveSockets[socket.localPort()] = 0;
+    waitUntilDispatched();
+}
+
+void SimpleMessageProtocol::addSendSocket(SendSocket& socket)
+{
+    // No two sockets can bind to the same local port.
+    SendSocket* expected = 0;
+    if (!m_sendSockets[socket.localPort()].compare_exchange_strong(
+            expected, &socket))
     {
-        // No two sockets can bind to the same local port.
-        if (iter->localPort() == socket.localPort())
-        {
-            ::uNet::throw_exception(-1); // system_error
-        }
-        else if (iter->localPort() < socket.localPort())
-        {
-            prev_iter = iter;
-            continue;
-        }
+        ::uNet::throw_exception(-1); // system_error
+    }
+}
+
+void SimpleMessageProtocol::removeSendSocket(SendSocket& socket)
+{
+    UNET_ASSERT(m_sendSockets[socket.localPort()] == &socket);
+    m_sendSockets[socket.localPort()] = 0;
+    waitUntilDispatched();
+}
 
-        // The local port of the socket referenced by iter is higher than the
-        // local port of the new socket. Insert the socket just before the
-        // current position.
-        if (prev_iter == m_receiveSockets.end())
-            m_receiveSockets.push_front(socket);
-        else
-            m_receiveSockets.insert_after(prev_iter, socket);
-        break;
+void SimpleMessageProtocol::waitUntilDispatched()
+{
+    // A packet which is dispatched right now may still refer to a socket
+    // which has been removed from a table. Wait until its delivery is
+    // completed. Packets which are dispatched later on cannot see the
+    // socket anymore.
+    unsigned epoch = m_receiveEpoch;
+    if (epoch & 1)
+    {
+        while (m_receiveEpoch == epoch)
+            OperatingSystem::this_thread::yield();
     }
 }
 
-void SimpleMessageProtocol::removeReceiveSocket(ReceiveSocketBase& socket)
+void SimpleMessageProtocol::receiveCongestionNotification(HostAddress /*source*/,
+                                                          std::uint8_t port)
 {
-    OperatingSystem::lock_guard<OperatingSystem::mutex> lock(m_socketMutex);
-    m_receiveSockets.erase(m_receiveSockets.iterator_to(socket));
+    ++m_receiveEpoch;
+    SendSocket* socket = m_sendSockets[port];
+    if (socket)
+        socket->notifyCongestion();
+    ++m_receiveEpoch;
 }
 
-void SimpleMessageProtocol::receive(const ProtocolMetaData& /*metaData*/,
+void SimpleMessageProtocol::receive(const ProtocolMetaData& metaData,
                                     BufferBase& packet)
 {
     if (packet.size() < sizeof(SimpleMessageProtocolHeader))
@@ -207,29 +503,18 @@ void SimpleMessageProtocol::receive(const ProtocolMetaData& /*metaData*/,
         packet.dispose();
         return;
     }
-    std::cout << "This is a SMP message" << std::endl;
 
     const SimpleMessageProtocolHeader header
             = packet.pop_front<SimpleMessageProtocolHeader>();
 
-    std::cout << "{SMP} src: " << int(header.sourcePort)
-              << " dest: " << int(header.destinationPort) << std::endl;
-
-    OperatingSystem::lock_guard<OperatingSystem::mutex> lock(m_socketMutex);
-    if (m_receiveSockets.empty())
-    {
+    ++m_receiveEpoch;
+    ReceiveSocketBase* socket = m_receiveSockets[header.destinationPort];
+    if (socket)
+        socket->deliver(metaData.npHeader.sourceAddress, header.sourcePort,
+                        packet);
+    else
         packet.dispose();
-        return;
-    }
-
-    for (receiver_socket_list_t::iterator iter = m_receiveSockets.begin(),
-                                      end_iter = m_receiveSockets.end();
-         iter != end_iter; ++iter)
-    {
-        if (iter->filterPacket(header.destinationPort, packet))
-            return;
-    }
-    packet.dispose();
+    ++m_receiveEpoch;
 }
 
 void SimpleMessageProtocol::send(
@@ -250,4 +535,15 @@ void SimpleMessageProtocol::send(
                    message);
 }
 
+void SimpleMessageProtocol::sendCongestionNotification(
+        HostAddress destinationAddress, std::uint8_t port)
+{
+    if (m_kernel)
+    {
+        m_kernel->sendCongestionNotification(
+                    destinationAddress, SimpleMessageProtocol::headerType,
+                    port);
+    }
+}
+
 } // namespace uNet
@@ -7,6 +7,8 @@
 
 #include "OperatingSystem/OperatingSystem.h"
 
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
 
 namespace uNet
@@ -30,6 +32,8 @@ a dispatcher, which maps incoming packets from a port number to a service.
 
 */
 
+class Poller;
+class ReceiveConnection;
 class ReceiveSocketBase;
 class SendSocket;
 class SimpleMessageProtocol;
@@ -48,7 +52,13 @@ namespace detail
 struct ReceiveConnectionDescriptor
 {
     ReceiveConnectionDescriptor(ReceiveSocketBase& socket)
-        : m_receiveSocket(socket)
+        : m_receiveSocket(socket),
+          m_queueLength(0),
+          m_numDropped(0),
+          m_numCongestedFlows(0),
+          m_poller(0),
+          m_connection(0),
+          m_ready(false)
     {
     }
 
@@ -59,6 +69,19 @@ struct ReceiveConnectionDescriptor
 
     OperatingSystem::mutex m_mutex;
     BufferQueue m_packetQueue;
+    //! The number of packets in the queue.
+    std::size_t m_queueLength;
+    //! The number of packets which have been dropped because the queue was
+    //! full.
+    unsigned m_numDropped;
+
+    //! The maximum number of flows which are remembered as congested.
+    static const unsigned maxNumCongestedFlows = 4;
+    //! The flows (source address and port) which have been sent a
+    //! congestion notification since a packet has been queued the last time.
+    std::uint32_t m_congestedFlows[maxNumCongestedFlows];
+    //! The number of congested flows.
+    unsigned m_numCongestedFlows;
 
     typedef boost::intrusive::slist_member_hook<
         boost::intrusive::link_mode<boost::intrusive::normal_link> >
@@ -66,6 +89,15 @@ struct ReceiveConnectionDescriptor
     //! A hook to add this descriptor to a list.
     descriptor_list_hook_t m_desriptorListHook;
 
+    //! The poller with which the connection has been registered.
+    Poller* m_poller;
+    //! The registered connection.
+    ReceiveConnection* m_connection;
+    //! Set while the descriptor is in the poller's ready list.
+    bool m_ready;
+    //! A hook to add this descriptor to the ready list of a poller.
+    descriptor_list_hook_t m_readyListHook;
+
     friend class ReceiveSocketBase;
 };
 
@@ -118,27 +150,175 @@ public:
             ::uNet::throw_exception(-1); //! \todo system_error
 
         m_descriptor->m_packetSemaphore.try_wait_for(d);
-        OperatingSystem::lock_guard<OperatingSystem::mutex> queueLock(
-                    m_descriptor->m_mutex);
-        if (m_descriptor->m_packetQueue.empty())
-            return 0;
-        else
-        {
-            BufferBase& buffer = m_descriptor->m_packetQueue.front();
-            m_descriptor->m_packetQueue.pop_front();
-            return &buffer;
-        }
+        return dequeue();
     }
 
+    //! Returns the number of packets which have been dropped because the
+    //! queue of this connection or of its socket was full.
+    unsigned numDropped() const;
+
+    //! Tries to receive a packet.
+    //! Returns a pending packet or a null-pointer, if there is none. The
+    //! calling thread is not blocked.
+    BufferBase* try_receive();
+
 private:
     detail::ReceiveConnectionDescriptor* m_descriptor;
+
+    friend class Poller;
+
+    //! Removes the first packet from the queue. Returns a null-pointer, if
+    //! the queue is empty.
+    BufferBase* dequeue();
+};
+
+//! A multiplexer for receive connections.
+//! The Poller waits for any of many receive connections to become readable.
+//! A single thread can thus serve many ports instead of blocking in
+//! ReceiveConnection::receive() with one thread per connection.
+//!
+//! The poller is edge-triggered. A connection is added to the ready list
+//! when a packet arrives while its queue is empty. wait() removes the
+//! connection from the list again. Afterwards, the caller has to drain the
+//! connection with ReceiveConnection::try_receive() until it returns a
+//! null-pointer. Otherwise, the connection is not reported again.
+//!
+//! A registered connection must not be moved. It is removed from the
+//! poller automatically when it is closed.
+class Poller : boost::noncopyable
+{
+public:
+    Poller();
+
+    //! Destroys the poller. All connections must have been removed.
+    ~Poller();
+
+    //! Registers a connection.
+    //! Adds the \p connection to the poller. If packets are pending in the
+    //! connection, it is ready immediately. A connection can only be
+    //! registered with one poller at a time.
+    void add(ReceiveConnection& connection);
+
+    //! Returns the number of registered connections.
+    std::size_t size() const;
+
+    //! Removes the \p connection from the poller.
+    void remove(ReceiveConnection& connection);
+
+    //! Tries to wait for a readable connection within a timeout.
+    //! Behaves like wait() but blocks the calling thread at most for the
+    //! duration \p d. Returns a null-pointer, if no connection has become
+    //! readable in this time or if the ready connection has been removed
+    //! in the meantime.
+    template <typename RepT, typename PeriodT>
+    ReceiveConnection* try_wait_for(
+            const OperatingSystem::chrono::duration<RepT, PeriodT>& d)
+    {
+        if (!m_nonEmpty.try_wait_for(d))
+            return 0;
+        return popReady();
+    }
+
+    //! Waits for a readable connection.
+    //! Blocks the calling thread until a connection is ready and returns
+    //! it.
+    ReceiveConnection* wait();
+
+private:
+    //! A mutex to synchronize accesses to the ready list.
+    mutable OperatingSystem::mutex m_mutex;
+
+    typedef boost::intrusive::slist<
+            detail::ReceiveConnectionDescriptor,
+            boost::intrusive::member_hook<
+                detail::ReceiveConnectionDescriptor,
+                detail::ReceiveConnectionDescriptor::descriptor_list_hook_t,
+                &detail::ReceiveConnectionDescriptor::m_readyListHook>,
+            boost::intrusive::cache_last<true> > ready_list_t;
+    //! The connections which have become readable.
+    ready_list_t m_readyList;
+    //! The number of registered connections.
+    std::size_t m_numConnections;
+    //! Signals that the ready list is not empty. The semaphore is posted
+    //! when a connection is added to an empty list.
+    OperatingSystem::semaphore m_nonEmpty;
+
+    //! Removes the \p descriptor from the poller. The descriptor's mutex
+    //! must be locked.
+    void detach(detail::ReceiveConnectionDescriptor& descriptor);
+
+    //! Removes the first connection from the ready list.
+    ReceiveConnection* popReady();
+
+    //! Adds the \p descriptor to the ready list. The descriptor's mutex
+    //! must be locked.
+    void setReady(detail::ReceiveConnectionDescriptor& descriptor);
+
+    friend class ReceiveSocketBase;
+};
+
+//! The statistics of a receive socket.
+struct ReceiveSocketStatistics
+{
+    ReceiveSocketStatistics()
+        : numQueued(0),
+          numDropped(0),
+          numCongestionNotifications(0)
+    {
+    }
+
+    //! The number of packets which are queued in the connections.
+    unsigned numQueued;
+    //! The number of packets which have been dropped because a queue was
+    //! full.
+    unsigned numDropped;
+    //! The number of congestion notifications which have been sent.
+    unsigned numCongestionNotifications;
 };
 
 //! The base class for all receive sockets.
 //! ReceiveSocketBase is the base class for all receive sockets.
+//!
+//! A socket can have several open connections, e.g. one per worker thread.
+//! An incoming packet is delivered to exactly one of them. The delivery
+//! policy determines which connection receives the packet.
+//!
+//! The number of packets which wait in the queue of a connection and in
+//! the queues of all connections of the socket can be limited. This keeps
+//! a slow consumer from holding all buffers of the kernel. The overflow
+//! policy determines what happens to a packet which exceeds a limit.
 class ReceiveSocketBase : boost::noncopyable
 {
 public:
+    //! The policies for handling a packet which exceeds a queue limit.
+    enum OverflowPolicy
+    {
+        //! The incoming packet is dropped.
+        DropNewest,
+        //! The oldest packet in the connection's queue is dropped to make
+        //! room for the incoming packet. If the connection's queue is empty,
+        //! the incoming packet is dropped.
+        DropOldest,
+        //! The incoming packet is dropped and the sender is notified with
+        //! an NCP congestion notification. Every flow (source address and
+        //! port) is only notified about the first of its packets which is
+        //! dropped by a connection until the connection queues a packet
+        //! again.
+        Backpressure
+    };
+
+    //! The policies for distributing packets across connections.
+    enum DeliveryPolicy
+    {
+        //! The connections receive the packets in turn.
+        RoundRobin,
+        //! The connection is selected by a hash of the source address and
+        //! the source port. All packets of a flow are delivered to the same
+        //! connection and thus keep their order, as long as no connection
+        //! is opened or closed.
+        FlowHash
+    };
+
     //! Creates a receive socket.
     //! Creates a receive socket which belongs to the handler \p protocolHandler
     //! and is bound to the port \p localPort.
@@ -155,6 +335,36 @@ public:
     //! \internal
     void close(detail::ReceiveConnectionDescriptor* descriptor);
 
+    //! Returns the delivery policy.
+    DeliveryPolicy deliveryPolicy() const
+    {
+        OperatingSystem::lock_guard<OperatingSystem::mutex> lock(m_mutex);
+        return m_deliveryPolicy;
+    }
+
+    //! Returns the maximum number of packets in the queue of a connection.
+    //! Zero means that the queue is unlimited.
+    std::size_t maxConnectionQueueLength() const
+    {
+        OperatingSystem::lock_guard<OperatingSystem::mutex> lock(m_mutex);
+        return m_maxConnectionQueueLength;
+    }
+
+    //! Returns the maximum number of packets in the queues of all
+    //! connections. Zero means that the number is unlimited.
+    std::size_t maxSocketQueueLength() const
+    {
+        OperatingSystem::lock_guard<OperatingSystem::mutex> lock(m_mutex);
+        return m_maxSocketQueueLength;
+    }
+
+    //! Returns the overflow policy.
+    OverflowPolicy overflowPolicy() const
+    {
+        OperatingSystem::lock_guard<OperatingSystem::mutex> lock(m_mutex);
+        return m_overflowPolicy;
+    }
+
     //! Returns the local port.
     //! Returns the local port to which this socket is bound.
     std::uint8_t localPort() const
@@ -162,6 +372,40 @@ public:
         return m_localPort;
     }
 
+    //! Sets the delivery policy.
+    //! Sets the \p policy for distributing the incoming packets across the
+    //! connections. The default is FlowHash.
+    void setDeliveryPolicy(DeliveryPolicy policy)
+    {
+        OperatingSystem::lock_guard<OperatingSystem::mutex> lock(m_mutex);
+        m_deliveryPolicy = policy;
+    }
+
+    //! Sets the overflow policy.
+    //! Sets the \p policy for packets which exceed a queue limit. The
+    //! default is DropNewest.
+    void setOverflowPolicy(OverflowPolicy policy)
+    {
+        OperatingSystem::lock_guard<OperatingSystem::mutex> lock(m_mutex);
+        m_overflowPolicy = policy;
+    }
+
+    //! Limits the queues.
+    //! Limits the number of packets in the queue of every connection to
+    //! \p maxConnectionQueueLength and the total number of packets in the
+    //! queues of the socket to \p maxSocketQueueLength. A limit of zero
+    //! means that the number of packets is unlimited, which is the default.
+    void setQueueLimits(std::size_t maxConnectionQueueLength,
+                        std::size_t maxSocketQueueLength = 0)
+    {
+        OperatingSystem::lock_guard<OperatingSystem::mutex> lock(m_mutex);
+        m_maxConnectionQueueLength = maxConnectionQueueLength;
+        m_maxSocketQueueLength = maxSocketQueueLength;
+    }
+
+    //! Returns the statistics of the socket.
+    ReceiveSocketStatistics statistics() const;
+
 protected:
     //! Implemented by derived classes to allocate a new descriptor.
     virtual detail::ReceiveConnectionDescriptor* allocateDescriptor() = 0;
@@ -174,8 +418,23 @@ private:
     SimpleMessageProtocol& m_protocolHandler;
     //! The local port to which this socket is bound.
     std::uint8_t m_localPort;
-
-    OperatingSystem::mutex m_mutex;
+    //! The policy for distributing the packets across the connections.
+    DeliveryPolicy m_deliveryPolicy;
+    //! The policy for packets which exceed a queue limit.
+    OverflowPolicy m_overflowPolicy;
+    //! The maximum number of packets in the queue of a connection.
+    std::size_t m_maxConnectionQueueLength;
+    //! The maximum number of packets in the queues of all connections.
+    std::size_t m_maxSocketQueueLength;
+    //! The number of packets in the queues of all connections. It is
+    //! decremented by the receivers without locking the socket's mutex.
+    std::atomic<unsigned> m_numQueued;
+    //! The number of dropped packets.
+    unsigned m_numDropped;
+    //! The number of congestion notifications which have been sent.
+    unsigned m_numCongestionNotifications;
+
+    mutable OperatingSystem::mutex m_mutex;
 
     typedef boost::intrusive::slist<
             detail::ReceiveConnectionDescriptor,
@@ -183,19 +442,24 @@ private:
                 detail::ReceiveConnectionDescriptor,
                 detail::ReceiveConnectionDescriptor::descriptor_list_hook_t,
                 &detail::ReceiveConnectionDescriptor::m_desriptorListHook>,
-            boost::intrusive::cache_last<false> > descriptor_list_t;
+            boost::intrusive::cache_last<true> > descriptor_list_t;
     //! A list of descriptors for open connections.
     descriptor_list_t m_descriptors;
 
-    bool filterPacket(std::uint8_t destinationPort, BufferBase& packet);
+    //! Passes the \p packet, which has been sent from the \p sourcePort of
+    //! the \p sourceAddress, to a connection or disposes it, if there is no
+    //! open connection.
+    void deliver(HostAddress sourceAddress, std::uint8_t sourcePort,
+                 BufferBase& packet);
 
-    friend class SimpleMessageProtocol;
+    //! Notifies the sender of a packet which has been dropped by the
+    //! connection with the \p descriptor about the congestion. Both the
+    //! socket's and the descriptor's mutex must be locked.
+    void notifyCongestion(detail::ReceiveConnectionDescriptor& descriptor,
+                          HostAddress sourceAddress, std::uint8_t sourcePort);
 
-public:
-    typedef boost::intrusive::slist_member_hook<
-        boost::intrusive::link_mode<boost::intrusive::normal_link> >
-        socket_list_hook_t;
-    socket_list_hook_t m_socketListHook;
+    friend class ReceiveConnection;
+    friend class SimpleMessageProtocol;
 };
 
 //! A concrete receive socket.
@@ -262,32 +526,100 @@ class SendSocketBase : boost::noncopyable
 };
 
 //! A send socket.
+//! The SendSocket sends packets from its local port. If a receiver drops a
+//! packet of this socket because its queue is full and the receive socket
+//! uses the Backpressure policy, the socket is notified. The sender should
+//! slow down while the socket is congested().
 //template <unsigned TMaxNumConnections>
 class SendSocket : public SendSocketBase
 {
 public:
+    //! Creates a send socket.
+    //! Creates a send socket which sends messages via the \p protocolHandler
+    //! from the given \p localPort. Only one send socket can be bound to a
+    //! port.
     SendSocket(SimpleMessageProtocol& protocolHandler, std::uint8_t localPort);
 
+    //! Destroys the send socket.
+    ~SendSocket();
+
     BufferBase* allocate();
+
+    //! Clears the congestion flag.
+    //! Resets the flag which is returned by congested().
+    void clearCongestion();
+
+    //! Checks for congestion.
+    //! Returns \p true, if a congestion notification has been received
+    //! since the socket has been created or since the last call to
+    //! clearCongestion().
+    bool congested() const;
+
     SendConnection connect(HostAddress destinationAddress,
                            std::uint8_t destinationPort);
 
+    //! Returns the local port.
+    std::uint8_t localPort() const
+    {
+        return m_localPort;
+    }
+
+    //! Returns the number of congestion notifications which have been
+    //! received.
+    unsigned numCongestionNotifications() const;
+
     void send(SendConnection& con, BufferBase* packet);
 
 private:
     SimpleMessageProtocol& m_protocolHandler;
     std::uint8_t m_localPort;
+    //! Set when a congestion notification is received.
+    std::atomic<bool> m_congested;
+    //! The number of received congestion notifications.
+    std::atomic<unsigned> m_numCongestionNotifications;
+
+    //! Called by the protocol handler when a congestion notification has
+    //! been received.
+    void notifyCongestion();
+
+    friend class SimpleMessageProtocol;
 };
 
+//! The Simple Message Protocol handler.
+//! The handler demultiplexes incoming packets to the receive sockets by
+//! their destination port. As the ports are bytes, the sockets are kept in
+//! a table with one atomic pointer per port. The look-up of a socket is a
+//! single load and does not lock a mutex.
+//!
+//! Binding and unbinding a socket are the expensive operations. When a
+//! socket is unbound, its table entry is cleared and the caller waits until
+//! the packet which is being dispatched at this moment (if any) has been
+//! delivered. Afterwards, no other thread refers to the socket and it can
+//! be destroyed. This requires that packets are received by a single
+//! thread, which is the kernel's event loop.
+//!
+//! The send sockets are kept in a second table, through which congestion
+//! notifications are passed on to the socket which has sent the dropped
+//! packet.
 class SimpleMessageProtocol
 {
 public:
     //! The value of the "Next header" field in the network protocol.
     static const std::uint8_t headerType = 2;
 
+    //! The number of bytes which the protocol prepends to a message.
+    static const std::size_t max_header_size
+        = sizeof(SimpleMessageProtocolHeader);
+
     SimpleMessageProtocol()
-        : m_kernel(0)
+        : m_kernel(0),
+          m_receiveEpoch(0)
     {
+        for (unsigned port = 0; port < 256; ++port)
+        {
+            m_receiveSockets[port] = 0;
+            m_sendSockets[port] = 0;
+        }
     }
 
     //! Filters incoming packets.
@@ -305,10 +637,22 @@ public:
     //! protocol header \p metaData.
     void receive(const ProtocolMetaData& metaData, BufferBase& packet);
 
+    //! Handles a congestion notification.
+    //! Passes a congestion notification from the \p source on to the send
+    //! socket which is bound to the local \p port. This method is called by
+    //! the kernel's event loop.
+    void receiveCongestionNotification(HostAddress source, std::uint8_t port);
+
     void send(std::uint8_t sourcePort,
               HostAddress destinationAddress, std::uint8_t destinationPort,
               BufferBase& message);
 
+    //! Notifies a sender about congestion.
+    //! Sends an NCP congestion notification to the \p destinationAddress
+    //! that a packet which has been sent from its \p port has been dropped.
+    void sendCongestionNotification(HostAddress destinationAddress,
+                                    std::uint8_t port);
+
     //! Sets the associated kernel.
     //! Associates this protocol handler with the given \p kernel.
     void setKernel(KernelBase* kernel)
@@ -319,23 +663,24 @@ public:
 private:
     void addReceiveSocket(ReceiveSocketBase& socket);
     void removeReceiveSocket(ReceiveSocketBase& socket);
+    void addSendSocket(SendSocket& socket);
+    void removeSendSocket(SendSocket& socket);
+    void waitUntilDispatched();
 
     KernelBase* m_kernel;
 
-    OperatingSystem::mutex m_socketMutex;
-
-    typedef boost::intrusive::slist<
-                ReceiveSocketBase,
-                boost::intrusive::member_hook<
-                    ReceiveSocketBase,
-                    ReceiveSocketBase::socket_list_hook_t,
-                    &ReceiveSocketBase::m_socketListHook>,
-                boost::intrusive::cache_last<false> > receiver_socket_list_t;
-    //! A list of receiver sockets which belong to this protocol handler.
-    receiver_socket_list_t m_receiveSockets;
+    //! The receive sockets indexed by their local port.
+    std::atomic<ReceiveSocketBase*> m_receiveSockets[256];
+    //! The send sockets indexed by their local port.
+    std::atomic<SendSocket*> m_sendSockets[256];
+    //! Incremented when the dispatching of a packet or a notification
+    //! begins and when it ends. An odd value means that a dispatch is in
+    //! progress.
+    std::atomic<unsigned> m_receiveEpoch;
 
     friend class Socket;
     friend class ReceiveSocketBase;
+    friend class SendSocket;
 };
 
 } // namespace uNet
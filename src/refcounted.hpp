@@ -1,19 +1,23 @@
 #ifndef UNET_REFCOUNTED_HPP
 #define UNET_REFCOUNTED_HPP
 
+#include "config.hpp"
+
 #include <OperatingSystem/OperatingSystem.h>
 
+#include <atomic>
+
 namespace uNet
 {
 
-//! A poor mans reference counter.
-//!
-//! \todo This should actually be a std::atomic<unsigned> and use atomic
-//! memory accesses rather than blocking a mutex whenever the reference
-//! count is changed.
-struct ReferenceCounter
+namespace detail
+{
+
+//! A reference counter which is protected by a mutex.
+//! This counter is used on targets without atomic operations.
+struct MutexReferenceCounter
 {
-    ReferenceCounter()
+    MutexReferenceCounter()
         : m_value(0)
     {
     }
@@ -31,10 +35,80 @@ struct ReferenceCounter
         return m_value > 0;
     }
 
+    //! Decrements the counter unless it is zero. Returns \p true, if the
+    //! counter has been decremented.
+    bool tryDec()
+    {
+        OperatingSystem::lock_guard<OperatingSystem::mutex> lock(m_mutex);
+        if (m_value == 0)
+            return false;
+        --m_value;
+        return true;
+    }
+
     OperatingSystem::mutex m_mutex;
     unsigned m_value;
 };
 
+//! A lock-free reference counter.
+//! Incrementing the counter needs no ordering because a new reference can
+//! only be created from an existing one. Decrementing it has release
+//! semantics such that all accesses to the object happen before the object
+//! is disposed. The thread which drops the last reference synchronizes with
+//! the other threads by an acquire operation.
+struct AtomicReferenceCounter
+{
+    AtomicReferenceCounter()
+        : m_value(0)
+    {
+    }
+
+    void inc()
+    {
+        m_value.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    bool dec()
+    {
+        if (m_value.fetch_sub(1, std::memory_order_release) != 1)
+            return true;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return false;
+    }
+
+    //! Decrements the counter unless it is zero. Returns \p true, if the
+    //! counter has been decremented.
+    bool tryDec()
+    {
+        unsigned value = m_value.load(std::memory_order_acquire);
+        while (value != 0)
+        {
+            if (m_value.compare_exchange_weak(value, value - 1,
+                                              std::memory_order_release,
+                                              std::memory_order_acquire))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::atomic<unsigned> m_value;
+};
+
+} // namespace detail
+
+//! The reference counter.
+//! Unless UNET_NO_ATOMICS is defined in the user config, the reference
+//! counter is lock-free. Otherwise, it is protected by a mutex. The macro
+//! only selects the reference counter; the rest of the library uses
+//! std::atomic regardless.
+#if defined(UNET_NO_ATOMICS)
+typedef detail::MutexReferenceCounter ReferenceCounter;
+#else
+typedef detail::AtomicReferenceCounter ReferenceCounter;
+#endif // UNET_NO_ATOMICS
+
 //! A pointer to a reference counted object.
 //!
 //! Requires the following 3 free functions:
@@ -3,33 +3,108 @@
 namespace uNet
 {
 
-RoutingTable::RoutingTable()
-    : m_numEntries(0)
+// Returns the number of bits which are set in a netmask.
+static unsigned prefixLength(std::uint16_t netmask)
 {
+    unsigned length = 0;
+    for (; netmask; netmask &= netmask - 1)
+        ++length;
+    return length;
 }
 
-void RoutingTable::addStaticRoute(NetworkAddress targetNetwork,
-                                  HostAddress nextNeighbor)
+RoutingTableBase::RoutingTableBase(RoutingTableEntry* entries,
+                                   std::size_t capacity)
+    : m_tableEntries(entries),
+      m_capacity(capacity),
+      m_numEntries(0)
 {
-    if (m_numEntries >= 10)
+}
+
+void RoutingTableBase::addStaticRoute(NetworkAddress targetNetwork,
+                                      HostAddress nextNeighbor)
+{
+    if (!tryAddStaticRoute(targetNetwork, nextNeighbor))
         ::uNet::throw_exception(-1); //! \todo system_error
+}
+
+bool RoutingTableBase::tryAddStaticRoute(NetworkAddress targetNetwork,
+                                         HostAddress nextNeighbor)
+{
+    // Replace the route for an existing network.
+    std::size_t idx = findNetwork(targetNetwork);
+    if (idx < m_numEntries)
+    {
+        m_tableEntries[idx].m_nextNeighbor = nextNeighbor;
+        m_tableEntries[idx].m_static = true;
+        return true;
+    }
+
+    if (m_numEntries >= m_capacity)
+        return false;
 
-    m_tableEntries[m_numEntries].m_targetNetwork = targetNetwork;
-    m_tableEntries[m_numEntries].m_nextNeighbor = nextNeighbor;
-    m_tableEntries[m_numEntries].m_static = true;
+    // Insert the route behind all routes with a longer or equal prefix.
+    unsigned length = prefixLength(targetNetwork.netmask());
+    for (idx = m_numEntries;
+         idx > 0 && m_tableEntries[idx - 1].m_prefixLength < length; --idx)
+    {
+        m_tableEntries[idx] = m_tableEntries[idx - 1];
+    }
+
+    m_tableEntries[idx].m_targetNetwork = targetNetwork;
+    m_tableEntries[idx].m_nextNeighbor = nextNeighbor;
+    m_tableEntries[idx].m_static = true;
+    m_tableEntries[idx].m_prefixLength = length;
     ++m_numEntries;
+    return true;
 }
 
-HostAddress RoutingTable::resolve(HostAddress destination) const
+bool RoutingTableBase::removeStaticRoute(NetworkAddress targetNetwork)
 {
+    std::size_t idx = findNetwork(targetNetwork);
+    if (idx == m_numEntries)
+        return false;
+
+    --m_numEntries;
+    for (; idx < m_numEntries; ++idx)
+        m_tableEntries[idx] = m_tableEntries[idx + 1];
+    return true;
+}
+
+HostAddress RoutingTableBase::resolve(HostAddress destination) const
+{
+    std::size_t idx = findRoute(destination);
+    return idx < m_numEntries ? m_tableEntries[idx].m_nextNeighbor
+                              : destination;
+}
+
+std::size_t RoutingTableBase::findRoute(HostAddress destination) const
+{
+    // As the entries are sorted by their prefix length, the first match is
+    // the longest one.
     for (std::size_t idx = 0; idx < m_numEntries; ++idx)
     {
         if (destination.isInSubnet(m_tableEntries[idx].m_targetNetwork))
         {
-            return m_tableEntries[idx].m_nextNeighbor;
+            return idx;
+        }
+    }
+    return m_numEntries;
+}
+
+std::size_t RoutingTableBase::findNetwork(NetworkAddress targetNetwork) const
+{
+    std::uint16_t netmask = targetNetwork.netmask();
+    std::uint16_t prefix = targetNetwork.hostAddress().address() & netmask;
+    for (std::size_t idx = 0; idx < m_numEntries; ++idx)
+    {
+        const NetworkAddress& network = m_tableEntries[idx].m_targetNetwork;
+        if (   network.netmask() == netmask
+            && (network.hostAddress().address() & netmask) == prefix)
+        {
+            return idx;
         }
     }
-    return destination;
+    return m_numEntries;
 }
 
 } // namespace uNet
@@ -3,6 +3,10 @@
 
 #include "networkaddress.hpp"
 
+#include <boost/static_assert.hpp>
+
+#include <cstddef>
+
 namespace uNet
 {
 //! An entry in the routing table.
@@ -16,33 +20,108 @@ public:
     HostAddress m_nextNeighbor;
     //! If set, this entry has been statically configured.
     bool m_static;
+    //! The length of the target network's prefix, i.e. the number of bits
+    //! which are set in its netmask.
+    unsigned m_prefixLength;
 };
 
-//! The routing table.
-//! The RoutingTable resolves a destination address to a neighbor address. In
-//! other words, for any in the network destination it returns the address to
-//! which the message must be routed next.
-class RoutingTable
+//! The base class of all routing tables.
+//! The RoutingTableBase resolves a destination address to a neighbor
+//! address. In other words, for any in the network destination it returns
+//! the address to which the message must be routed next.
+//!
+//! The entries are kept sorted by the length of their network prefix with
+//! the longest prefix first. The first route which matches a destination is
+//! therefore the route with the longest matching prefix. The storage for
+//! the entries is provided by the derived RoutingTable.
+class RoutingTableBase
 {
 public:
-    RoutingTable();
-
     //! Adds a static route.
     //! Adds a static entry to the routing table which routes packets for
-    //! the \p targetNetwork via the \p nextNeighbor.
+    //! the \p targetNetwork via the \p nextNeighbor. If there is already a
+    //! route for the \p targetNetwork, its next neighbor is replaced. If
+    //! the table is full, an exception is thrown.
     void addStaticRoute(NetworkAddress targetNetwork,
                         HostAddress nextNeighbor);
 
+    //! Tries to add a static route.
+    //! Adds a static route like addStaticRoute(). If the table is full,
+    //! \p false is returned instead of throwing an exception.
+    bool tryAddStaticRoute(NetworkAddress targetNetwork,
+                           HostAddress nextNeighbor);
+
+    //! Returns the maximum number of routes.
+    std::size_t capacity() const
+    {
+        return m_capacity;
+    }
+
+    //! Removes a static route.
+    //! Removes the route for the \p targetNetwork from the routing table.
+    //! Returns \p true, if such a route existed.
+    bool removeStaticRoute(NetworkAddress targetNetwork);
+
     //! Resolves an address.
     //! Looks up the \p destination address in the routing table and returns
     //! the host address of the next neighbor, which is the next target for
     //! the message.
     HostAddress resolve(HostAddress destination) const;
 
+    //! Finds the route for an address.
+    //! Returns the index of the route which is used for the \p destination
+    //! address. If no route matches, numRoutes() is returned.
+    std::size_t findRoute(HostAddress destination) const;
+
+    //! Returns the number of routes.
+    std::size_t numRoutes() const
+    {
+        return m_numEntries;
+    }
+
+    //! Returns the route with the given \p index.
+    const RoutingTableEntry& route(std::size_t index) const
+    {
+        UNET_ASSERT(index < m_numEntries);
+        return m_tableEntries[index];
+    }
+
+protected:
+    //! Creates a routing table.
+    //! Creates a routing table which stores up to \p capacity entries in
+    //! the array \p entries.
+    RoutingTableBase(RoutingTableEntry* entries, std::size_t capacity);
+
 private:
     //! The table entries.
-    RoutingTableEntry m_tableEntries[10];
+    RoutingTableEntry* m_tableEntries;
+    //! The maximum number of entries.
+    std::size_t m_capacity;
+    //! The number of entries in use.
     std::size_t m_numEntries;
+
+    //! Returns the index of the route for exactly the \p targetNetwork or
+    //! numRoutes(), if there is no such route.
+    std::size_t findNetwork(NetworkAddress targetNetwork) const;
+};
+
+//! The routing table.
+//! The RoutingTable is a RoutingTableBase with storage for
+//! \p TMaxNumRoutes routes.
+template <unsigned TMaxNumRoutes>
+class RoutingTable : public RoutingTableBase
+{
+    BOOST_STATIC_ASSERT(TMaxNumRoutes > 0);
+
+public:
+    RoutingTable()
+        : RoutingTableBase(m_entries, TMaxNumRoutes)
+    {
+    }
+
+private:
+    //! The storage for the entries.
+    RoutingTableEntry m_entries[TMaxNumRoutes];
 };
 
 } // namespace uNet
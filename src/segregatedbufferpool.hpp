@@ -0,0 +1,272 @@
+#ifndef UNET_SEGREGATEDBUFFERPOOL_HPP
+#define UNET_SEGREGATEDBUFFERPOOL_HPP
+
+#include "config.hpp"
+
+#include "buffer.hpp"
+#include "bufferpool.hpp"
+
+#include <boost/mpl/begin_end.hpp>
+#include <boost/mpl/deref.hpp>
+#include <boost/mpl/next.hpp>
+#include <boost/static_assert.hpp>
+
+#include <climits>
+#include <cstddef>
+
+namespace uNet
+{
+
+//! A size class of a SegregatedBufferPool.
+//! The buffer_class describes \p TNumBuffers buffers of \p TBufferSize bytes
+//! each. If \p TNumBuffers is zero, the number of buffers in this class is
+//! unlimited.
+template <unsigned TBufferSize, unsigned TNumBuffers>
+struct buffer_class
+{
+    BOOST_STATIC_ASSERT(TBufferSize > 0);
+
+    //! The size of one buffer in bytes.
+    static const unsigned buffer_size = TBufferSize;
+    //! The number of buffers.
+    static const unsigned num_buffers = TNumBuffers;
+};
+
+namespace detail
+{
+
+// One size class in a SegregatedBufferPool. Every size class holds a
+// BufferPool and inherits the larger size classes.
+template <typename TFirst, typename TLast>
+class BufferSizeClassChain
+        : public BufferSizeClassChain<typename boost::mpl::next<TFirst>::type,
+                                      TLast>
+{
+    typedef typename boost::mpl::deref<TFirst>::type class_t;
+    typedef BufferSizeClassChain<typename boost::mpl::next<TFirst>::type,
+                                 TLast> base_t;
+
+    // The size classes have to be sorted in ascending order.
+    BOOST_STATIC_ASSERT(class_t::buffer_size < base_t::min_buffer_size);
+
+public:
+    typedef BufferPool<class_t::buffer_size, class_t::num_buffers> pool_t;
+
+    static const unsigned num_classes = base_t::num_classes + 1;
+    static const unsigned min_buffer_size = class_t::buffer_size;
+
+    explicit BufferSizeClassChain(std::size_t headroom)
+        : base_t(headroom),
+          m_pool(headroom)
+    {
+    }
+
+    BufferBase* allocate(std::size_t sizeHint)
+    {
+        if (!fits(sizeHint))
+            return base_t::allocate(sizeHint);
+
+        // Prefer a larger buffer over blocking the caller.
+        BufferBase* buffer = try_allocate(sizeHint);
+        return buffer ? buffer : m_pool.allocate();
+    }
+
+    BufferBase* try_allocate(std::size_t sizeHint)
+    {
+        if (fits(sizeHint))
+        {
+            BufferBase* buffer = m_pool.try_allocate();
+            if (buffer)
+                return buffer;
+        }
+        return base_t::try_allocate(sizeHint);
+    }
+
+    BufferPoolStatistics statistics(unsigned sizeClass) const
+    {
+        return sizeClass == 0 ? m_pool.statistics()
+                              : base_t::statistics(sizeClass - 1);
+    }
+
+    void accumulateStatistics(BufferPoolStatistics& stats) const
+    {
+        BufferPoolStatistics own = m_pool.statistics();
+        stats.capacity += own.capacity;
+        stats.numAllocated += own.numAllocated;
+        stats.maxNumAllocated += own.maxNumAllocated;
+        stats.numAllocationFailures += own.numAllocationFailures;
+        base_t::accumulateStatistics(stats);
+    }
+
+    void trim(std::size_t maxNumFree)
+    {
+        m_pool.trim(maxNumFree);
+        base_t::trim(maxNumFree);
+    }
+
+    pool_t& pool()
+    {
+        return m_pool;
+    }
+
+    // Returns true, if a buffer of this class can hold sizeHint bytes. An
+    // oversized request is served by the largest class.
+    bool fits(std::size_t sizeHint) const
+    {
+        return base_t::num_classes == 0
+               || sizeHint <= class_t::buffer_size - m_pool.headroom();
+    }
+
+private:
+    pool_t m_pool;
+};
+
+template <typename TLast>
+class BufferSizeClassChain<TLast, TLast>
+{
+public:
+    static const unsigned num_classes = 0;
+    static const unsigned min_buffer_size = UINT_MAX;
+
+    explicit BufferSizeClassChain(std::size_t /*headroom*/)
+    {
+    }
+
+    BufferBase* allocate(std::size_t /*sizeHint*/)
+    {
+        UNET_ASSERT(false);
+        return 0;
+    }
+
+    BufferBase* try_allocate(std::size_t /*sizeHint*/)
+    {
+        return 0;
+    }
+
+    BufferPoolStatistics statistics(unsigned /*sizeClass*/) const
+    {
+        UNET_ASSERT(false);
+        return BufferPoolStatistics();
+    }
+
+    void accumulateStatistics(BufferPoolStatistics& /*stats*/) const
+    {
+    }
+
+    void trim(std::size_t /*maxNumFree*/)
+    {
+    }
+};
+
+} // namespace detail
+
+//! A buffer pool with several size classes.
+//! The SegregatedBufferPool consists of one BufferPool per size class. The
+//! size classes are given as an MPL sequence \p TClassList of buffer_class
+//! types, which has to be sorted by the buffer size in ascending order.
+//!
+//! A buffer is allocated from the smallest class which can hold the
+//! requested number of bytes in addition to the headroom. If
+//! this class is exhausted, the next larger class is used. Only if all of
+//! them are exhausted, a blocking allocation waits for the fitting class.
+template <typename TClassList>
+class SegregatedBufferPool : public BufferAllocator
+{
+public:
+    //! The list of size classes.
+    typedef TClassList class_list_t;
+
+    //! \internal
+    //! The chain of size classes.
+    typedef detail::BufferSizeClassChain<
+                typename boost::mpl::begin<TClassList>::type,
+                typename boost::mpl::end<TClassList>::type> chain_t;
+
+private:
+    BOOST_STATIC_ASSERT(chain_t::num_classes > 0);
+
+public:
+    //! The number of size classes.
+    static const unsigned num_classes = chain_t::num_classes;
+    //! The size of the buffers in the smallest class.
+    static const unsigned min_buffer_size = chain_t::min_buffer_size;
+
+    //! Creates a buffer pool whose buffers reserve \p headroom bytes in front
+    //! of the data.
+    explicit SegregatedBufferPool(
+            std::size_t headroom = BufferBase::defaultHeadroom)
+        : m_classes(headroom)
+    {
+    }
+
+    //! Allocates a buffer from the largest size class.
+    virtual BufferBase* allocate()
+    {
+        return m_classes.allocate(std::size_t(-1));
+    }
+
+    //! Allocates a buffer.
+    //! Allocates a buffer which can hold at least \p sizeHint bytes of data.
+    //! If the request exceeds the largest size class, a buffer of the largest
+    //! class is returned. The calling thread is blocked until a buffer is
+    //! available.
+    BufferBase* allocate(std::size_t sizeHint)
+    {
+        return m_classes.allocate(sizeHint);
+    }
+
+    //! Returns the accumulated statistics of all size classes. Note that
+    //! the high-water mark is the sum of the high-water marks of the
+    //! classes.
+    BufferPoolStatistics statistics() const
+    {
+        BufferPoolStatistics stats;
+        m_classes.accumulateStatistics(stats);
+        return stats;
+    }
+
+    //! Returns the statistics of the size class with the index
+    //! \p sizeClass.
+    BufferPoolStatistics statistics(unsigned sizeClass) const
+    {
+        UNET_ASSERT(sizeClass < num_classes);
+        return m_classes.statistics(sizeClass);
+    }
+
+    //! Releases unused memory.
+    //! Returns unused memory of the unlimited size classes to the heap until
+    //! at most \p maxNumFree buffers are free in each of them.
+    void trim(std::size_t maxNumFree = 0)
+    {
+        m_classes.trim(maxNumFree);
+    }
+
+    //! Tries to allocate a buffer from the largest size class.
+    virtual BufferBase* try_allocate()
+    {
+        return m_classes.try_allocate(std::size_t(-1));
+    }
+
+    //! Tries to allocate a buffer.
+    //! Allocates a buffer which can hold at least \p sizeHint bytes of data.
+    //! If no such buffer is available, a null-pointer is returned.
+    BufferBase* try_allocate(std::size_t sizeHint)
+    {
+        return m_classes.try_allocate(sizeHint);
+    }
+
+    //! \internal
+    //! Returns the chain of size classes.
+    chain_t& classes()
+    {
+        return m_classes;
+    }
+
+private:
+    //! The size classes.
+    chain_t m_classes;
+};
+
+} // namespace uNet
+
+#endif // UNET_SEGREGATEDBUFFERPOOL_HPP
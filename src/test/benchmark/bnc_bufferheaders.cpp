@@ -0,0 +1,129 @@
+// Measures a round trip of the network protocol and simple message protocol
+// headers through a buffer, i.e. prepending both headers and popping them
+// again. The BufferBase, which stores the bounds of its storage, is
+// compared with a buffer which queries its bounds via virtual functions
+// (the former implementation of BufferBase).
+
+#include "../../buffer.hpp"
+#include "../../networkprotocol.hpp"
+#include "../../protocol/simplemessageprotocol.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+static const std::size_t numRoundTrips = 20000000;
+
+// A buffer which retrieves the bounds of its storage via virtual functions.
+class VirtualBoundsBufferBase
+{
+public:
+    virtual ~VirtualBoundsBufferBase() {}
+
+    std::size_t front_capacity() const
+    {
+        return static_cast<std::size_t>(m_begin - storageBegin());
+    }
+
+    void clear()
+    {
+        m_begin = m_end = storageBegin() + 32;
+    }
+
+    template <typename TType>
+    TType pop_front()
+    {
+        TType temp;
+        std::memcpy(&temp, m_begin, sizeof(TType));
+        m_begin += sizeof(TType);
+        return temp;
+    }
+
+    template <typename TType>
+    void push_front(const TType& data)
+    {
+        m_begin -= sizeof(TType);
+        std::memcpy(m_begin, &data, sizeof(TType));
+    }
+
+protected:
+    virtual std::uint8_t* storageBegin() const = 0;
+    virtual std::uint8_t* storageEnd() const = 0;
+
+private:
+    std::uint8_t* m_begin;
+    std::uint8_t* m_end;
+};
+
+class VirtualBoundsBuffer : public VirtualBoundsBufferBase
+{
+protected:
+    virtual std::uint8_t* storageBegin() const
+    {
+        return const_cast<std::uint8_t*>(m_data);
+    }
+
+    virtual std::uint8_t* storageEnd() const
+    {
+        return const_cast<std::uint8_t*>(m_data) + sizeof(m_data);
+    }
+
+private:
+    std::uint8_t m_data[256];
+};
+
+// Prevents the compiler from seeing the dynamic type of the buffers.
+template <typename TBase, typename TBuffer>
+TBase* __attribute__((noinline)) createBuffer()
+{
+    return new TBuffer;
+}
+
+template <typename TBuffer>
+double measure(TBuffer* buffer)
+{
+    uNet::NetworkProtocolHeader npHeader;
+    uNet::SimpleMessageProtocolHeader smpHeader
+            = uNet::SimpleMessageProtocolHeader();
+    volatile std::uint8_t sink = 0;
+
+    std::chrono::steady_clock::time_point start
+            = std::chrono::steady_clock::now();
+
+    for (std::size_t idx = 0; idx < numRoundTrips; ++idx)
+    {
+        buffer->clear();
+        smpHeader.sourcePort = idx;
+        if (buffer->front_capacity() < sizeof(smpHeader) + sizeof(npHeader))
+            std::abort();
+        buffer->push_front(smpHeader);
+        buffer->push_front(npHeader);
+        sink = buffer->template pop_front<uNet::NetworkProtocolHeader>()
+                   .nextHeader;
+        sink = buffer->template pop_front<uNet::SimpleMessageProtocolHeader>()
+                   .sourcePort;
+    }
+
+    std::chrono::steady_clock::time_point stop
+            = std::chrono::steady_clock::now();
+    (void)sink;
+
+    return std::chrono::duration<double, std::nano>(stop - start).count()
+           / numRoundTrips;
+}
+
+int main()
+{
+    VirtualBoundsBufferBase* virtualBuffer
+            = createBuffer<VirtualBoundsBufferBase, VirtualBoundsBuffer>();
+    uNet::BufferBase* buffer
+            = createBuffer<uNet::BufferBase, uNet::Buffer<256, 4> >();
+
+    std::printf("%16s %16s\n", "virtual bounds", "BufferBase");
+    std::printf("%13.2f ns %13.2f ns\n",
+                measure(virtualBuffer), measure(buffer));
+
+    delete virtualBuffer;
+    delete buffer;
+    return 0;
+}
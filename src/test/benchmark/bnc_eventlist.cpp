@@ -0,0 +1,64 @@
+// Compares the throughput of the mutex-based EventList with the
+// LockFreeEventList when several producer threads enqueue events at the
+// same time and a single consumer retrieves them.
+
+#include "../../event.hpp"
+#include "../../lockfreeeventlist.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+static const std::size_t numEventsPerProducer = 200000;
+
+template <typename TEventList>
+double measure(std::size_t numProducers)
+{
+    TEventList* eventList = new TEventList;
+    uNet::Event ev = uNet::Event::createMessageSendEvent(0);
+
+    std::chrono::steady_clock::time_point start
+            = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> producers;
+    for (std::size_t p = 0; p < numProducers; ++p)
+    {
+        producers.push_back(std::thread([eventList, &ev] {
+            for (std::size_t idx = 0; idx < numEventsPerProducer; ++idx)
+                eventList->copy_enqueue(ev);
+        }));
+    }
+
+    for (std::size_t count = 0; count < numProducers * numEventsPerProducer;
+         ++count)
+    {
+        eventList->retrieve();
+    }
+
+    std::chrono::steady_clock::time_point stop
+            = std::chrono::steady_clock::now();
+
+    for (std::size_t p = 0; p < numProducers; ++p)
+        producers[p].join();
+    delete eventList;
+
+    return std::chrono::duration<double, std::nano>(stop - start).count()
+           / (numProducers * numEventsPerProducer);
+}
+
+int main()
+{
+    const std::size_t numProducers[] = {1, 4, 16};
+
+    std::printf("%10s %16s %16s\n", "producers", "EventList", "LockFree");
+    for (std::size_t idx = 0; idx < 3; ++idx)
+    {
+        double mutexList = measure<uNet::EventList<64> >(numProducers[idx]);
+        double lockFreeList = measure<uNet::LockFreeEventList<64> >(
+                                  numProducers[idx]);
+        std::printf("%10u %13.1f ns %13.1f ns\n",
+                    unsigned(numProducers[idx]), mutexList, lockFreeList);
+    }
+    return 0;
+}
@@ -0,0 +1,113 @@
+// Measures the cost of copying a refcounted_ptr<BufferBase> and compares the
+// lock-free reference counter with the mutex-based one when several threads
+// share the same buffer.
+
+#include "../../buffer.hpp"
+#include "../../refcounted.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+static const std::size_t numCopiesPerThread = 1000000;
+
+typedef uNet::Buffer<256, 4> buffer_t;
+
+// A disposer which keeps the buffer alive.
+class NullDisposer : public uNet::BufferDisposer
+{
+public:
+    virtual void dispose(uNet::BufferBase*)
+    {
+    }
+};
+
+// Copies a pointer to a shared buffer from several threads. Returns the time
+// per copy (including the destruction of the copy) in nanoseconds.
+double measurePointerCopy(std::size_t numThreads)
+{
+    NullDisposer disposer;
+    buffer_t buffer(&disposer);
+    uNet::refcounted_ptr<uNet::BufferBase> ptr(&buffer);
+
+    std::chrono::steady_clock::time_point start
+            = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < numThreads; ++t)
+    {
+        threads.push_back(std::thread([&ptr] {
+            for (std::size_t idx = 0; idx < numCopiesPerThread; ++idx)
+            {
+                uNet::refcounted_ptr<uNet::BufferBase> copy(ptr);
+            }
+        }));
+    }
+    for (std::size_t t = 0; t < numThreads; ++t)
+        threads[t].join();
+
+    std::chrono::steady_clock::time_point stop
+            = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(stop - start).count()
+           / (numThreads * numCopiesPerThread);
+}
+
+// Increments and decrements a shared counter from several threads. Returns
+// the time per pair of operations in nanoseconds.
+template <typename TCounter>
+double measureCounter(std::size_t numThreads)
+{
+    TCounter counter;
+    counter.inc();
+
+    std::chrono::steady_clock::time_point start
+            = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < numThreads; ++t)
+    {
+        threads.push_back(std::thread([&counter] {
+            for (std::size_t idx = 0; idx < numCopiesPerThread; ++idx)
+            {
+                counter.inc();
+                counter.dec();
+            }
+        }));
+    }
+    for (std::size_t t = 0; t < numThreads; ++t)
+        threads[t].join();
+
+    std::chrono::steady_clock::time_point stop
+            = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::nano>(stop - start).count()
+           / (numThreads * numCopiesPerThread);
+}
+
+int main()
+{
+    const std::size_t numThreads[] = {1, 2, 4};
+
+    std::printf("sizeof(Mutex counter)  = %u\n",
+                unsigned(sizeof(uNet::detail::MutexReferenceCounter)));
+    std::printf("sizeof(Atomic counter) = %u\n\n",
+                unsigned(sizeof(uNet::detail::AtomicReferenceCounter)));
+
+    std::printf("%10s %16s %16s %16s\n",
+                "threads", "ptr copy", "Mutex", "Atomic");
+    for (std::size_t idx = 0; idx < 3; ++idx)
+    {
+        double copy = measurePointerCopy(numThreads[idx]);
+        double mutexCounter = measureCounter<
+                uNet::detail::MutexReferenceCounter>(numThreads[idx]);
+        double atomicCounter = measureCounter<
+                uNet::detail::AtomicReferenceCounter>(numThreads[idx]);
+        std::printf("%10u %13.1f ns %13.1f ns %13.1f ns\n",
+                    unsigned(numThreads[idx]), copy, mutexCounter,
+                    atomicCounter);
+    }
+
+    return 0;
+}
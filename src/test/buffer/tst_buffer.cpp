@@ -66,6 +66,20 @@ TEST(Buffer, dispose)
     ASSERT_EQ(3, disposer.numDisposedBuffers);
 }
 
+TEST(Buffer, dispose_shared)
+{
+    TestBufferDisposer disposer;
+    buffer_t b(&disposer);
+
+    b.share(2);
+    b.dispose();
+    b.dispose();
+    ASSERT_EQ(0, disposer.numDisposedBuffers);
+    b.dispose();
+    ASSERT_EQ(disposer.lastDisposedBuffer, &b);
+    ASSERT_EQ(1, disposer.numDisposedBuffers);
+}
+
 TEST(Buffer, push_back)
 {
     buffer_t b;
@@ -156,3 +170,110 @@ TEST(Buffer, push_and_pop_from_front)
         ASSERT_EQ(0x12348765, v);
     }
 }
+
+TEST(Buffer, append_and_extract)
+{
+    buffer_t b;
+    std::uint8_t data[100];
+    for (unsigned idx = 0; idx < sizeof(data); ++idx)
+        data[idx] = idx;
+
+    b.append(data, sizeof(data));
+    ASSERT_EQ(sizeof(data), b.size());
+    ASSERT_EQ(0, std::memcmp(b.begin(), data, sizeof(data)));
+
+    std::uint8_t part[10];
+    b.peek(20, part, sizeof(part));
+    ASSERT_EQ(0, std::memcmp(part, data + 20, sizeof(part)));
+    ASSERT_EQ(sizeof(data), b.size());
+
+    b.extract_front(part, sizeof(part));
+    ASSERT_EQ(0, std::memcmp(part, data, sizeof(part)));
+    ASSERT_EQ(sizeof(data) - sizeof(part), b.size());
+
+    b.prepend(data + 50, 16);
+    ASSERT_EQ(sizeof(data) - sizeof(part) + 16, b.size());
+    ASSERT_EQ(0, std::memcmp(b.begin(), data + 50, 16));
+    ASSERT_EQ(0, std::memcmp(b.begin() + 16, data + 10, 90));
+}
+
+class ExternalBufferDisposer : public uNet::BufferDisposer
+{
+public:
+    ExternalBufferDisposer()
+        : lastDisposedStorage(0),
+          numDisposedBuffers(0)
+    {
+    }
+
+    virtual void dispose(uNet::BufferBase* buffer)
+    {
+        lastDisposedStorage
+                = static_cast<uNet::ExternalBuffer*>(buffer)->storage();
+        ++numDisposedBuffers;
+    }
+
+    std::uint8_t* lastDisposedStorage;
+    int numDisposedBuffers;
+};
+
+class TestBufferGrabber : public uNet::BufferGrabber
+{
+public:
+    TestBufferGrabber()
+        : numGrabbedBuffers(0)
+    {
+    }
+
+    virtual void grab(uNet::BufferBase& /*buffer*/)
+    {
+        ++numGrabbedBuffers;
+    }
+
+    int numGrabbedBuffers;
+};
+
+TEST(ExternalBuffer, wraps_storage)
+{
+    std::uint8_t frame[64];
+    for (unsigned idx = 0; idx < sizeof(frame); ++idx)
+        frame[idx] = idx;
+
+    ExternalBufferDisposer disposer;
+    uNet::ExternalBuffer b(frame, sizeof(frame), &disposer);
+    ASSERT_EQ(0, b.size());
+    ASSERT_EQ(sizeof(frame), b.capacity());
+
+    // The data is not copied.
+    b.setData(4, 20);
+    ASSERT_EQ(frame + 4, b.begin());
+    ASSERT_EQ(20, b.size());
+    ASSERT_EQ(4, b.pop_front<std::uint8_t>());
+
+    b.dispose();
+    ASSERT_EQ(1, disposer.numDisposedBuffers);
+    ASSERT_EQ(frame, disposer.lastDisposedStorage);
+}
+
+TEST(ExternalBuffer, memento)
+{
+    std::uint8_t frame[64];
+    ExternalBufferDisposer disposer;
+    TestBufferGrabber grabber;
+    uNet::ExternalBuffer b(frame, sizeof(frame), &disposer, 16);
+    b.push_back(std::uint32_t(1));
+
+    uNet::BufferMemento memento(&grabber);
+    b.addMemento(memento);
+    b.push_front(std::uint32_t(2));
+
+    // The first disposal returns the buffer to the grabber.
+    b.dispose();
+    ASSERT_EQ(1, grabber.numGrabbedBuffers);
+    ASSERT_EQ(0, disposer.numDisposedBuffers);
+    ASSERT_EQ(4, b.size());
+
+    b.dispose();
+    ASSERT_EQ(1, grabber.numGrabbedBuffers);
+    ASSERT_EQ(1, disposer.numDisposedBuffers);
+}
@@ -0,0 +1,286 @@
+#include "../../buffercache.hpp"
+#include "../../bufferpool.hpp"
+#include "../../segregatedbufferpool.hpp"
+
+#include "gtest/gtest.h"
+
+#include <boost/mpl/vector.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+typedef uNet::BufferPool<256, 8> pool_t;
+typedef uNet::BufferCache<pool_t, 4> cache_t;
+
+TEST(BufferCache, Constructor)
+{
+    pool_t p;
+    cache_t c(p);
+    ASSERT_EQ(0, c.size());
+    ASSERT_EQ(0, p.statistics().numAllocated);
+}
+
+TEST(BufferCache, refill_in_batches)
+{
+    pool_t p;
+    cache_t c(p);
+
+    // The first allocation fetches half of the cache size from the pool.
+    uNet::BufferBase* b = c.allocate();
+    ASSERT_TRUE(b != 0);
+    ASSERT_EQ(&c, b->disposer());
+    ASSERT_EQ(1, c.size());
+    ASSERT_EQ(2, p.statistics().numAllocated);
+
+    // A disposed buffer goes back to the cache.
+    b->push_back(1);
+    b->dispose();
+    ASSERT_EQ(2, c.size());
+    ASSERT_EQ(2, p.statistics().numAllocated);
+
+    uNet::BufferBase* b2 = c.allocate();
+    ASSERT_EQ(0, b2->size());
+    b2->dispose();
+
+    c.flush();
+    ASSERT_EQ(0, c.size());
+    ASSERT_EQ(0, p.statistics().numAllocated);
+}
+
+TEST(BufferCache, overflow_goes_to_pool)
+{
+    pool_t p;
+    cache_t c(p);
+
+    uNet::BufferBase* buffers[8];
+    for (unsigned idx = 0; idx < 8; ++idx)
+        buffers[idx] = c.allocate();
+    ASSERT_EQ(0, c.size());
+    ASSERT_TRUE(c.try_allocate() == 0);
+
+    for (unsigned idx = 0; idx < 8; ++idx)
+        buffers[idx]->dispose();
+    ASSERT_EQ(4, c.size());
+    ASSERT_EQ(4, p.statistics().numAllocated);
+}
+
+TEST(BufferCache, dispose_from_other_thread)
+{
+    pool_t p;
+    cache_t c(p);
+
+    std::atomic<int> numDisposed(0);
+    uNet::BufferBase* buffers[4];
+    for (unsigned idx = 0; idx < 4; ++idx)
+        buffers[idx] = c.allocate();
+
+    std::thread t([&] {
+        for (unsigned idx = 0; idx < 4; ++idx)
+        {
+            buffers[idx]->dispose();
+            ++numDisposed;
+        }
+    });
+    t.join();
+
+    ASSERT_EQ(4, numDisposed);
+    ASSERT_EQ(4, c.size());
+    for (unsigned idx = 0; idx < 4; ++idx)
+        ASSERT_TRUE(c.try_allocate() != 0);
+    ASSERT_EQ(4, p.statistics().numAllocated);
+}
+
+TEST(BufferCache, allocate_blocks_on_empty_pool)
+{
+    pool_t p;
+    cache_t c(p);
+
+    pool_t::buffer_type* buffers[8];
+    for (unsigned idx = 0; idx < 8; ++idx)
+        buffers[idx] = p.allocate();
+
+    std::atomic<bool> allocated(false);
+    std::thread t([&] {
+        uNet::BufferBase* b = c.allocate();
+        allocated = true;
+        b->dispose();
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    ASSERT_FALSE(allocated);
+
+    p.release(buffers[0]);
+    t.join();
+    ASSERT_TRUE(allocated);
+
+    for (unsigned idx = 1; idx < 8; ++idx)
+        p.release(buffers[idx]);
+}
+
+TEST(BufferCache, allocate_wakes_up_on_dispose_from_other_thread)
+{
+    typedef uNet::BufferPool<256, 2> small_pool_t;
+    small_pool_t p;
+    uNet::BufferCache<small_pool_t, 4> c(p);
+
+    // The owner holds every buffer of the pool.
+    uNet::BufferBase* b1 = c.allocate();
+    uNet::BufferBase* b2 = c.allocate();
+    ASSERT_TRUE(p.empty());
+
+    // A buffer which is disposed while the owner is blocked has to end the
+    // blocking allocation.
+    std::thread t([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        b1->dispose();
+    });
+    uNet::BufferBase* b3 = c.allocate();
+    t.join();
+    ASSERT_TRUE(b3 != 0);
+    ASSERT_EQ(&c, b3->disposer());
+
+    b2->dispose();
+    b3->dispose();
+    c.flush();
+    ASSERT_EQ(0, p.statistics().numAllocated);
+}
+
+TEST(BufferCache, concurrent_allocate_and_dispose)
+{
+    typedef uNet::BufferPool<256, 2> small_pool_t;
+    small_pool_t p;
+    uNet::BufferCache<small_pool_t, 4> c(p);
+
+    // The owner passes its buffers to another thread, which disposes them.
+    // With only two buffers in the pool, the owner blocks frequently.
+    std::atomic<uNet::BufferBase*> handOver(0);
+    std::thread t([&] {
+        for (unsigned count = 0; count < 1000; ++count)
+        {
+            uNet::BufferBase* b;
+            while ((b = handOver.exchange(0)) == 0)
+                std::this_thread::yield();
+            b->dispose();
+        }
+    });
+    for (unsigned count = 0; count < 1000; ++count)
+    {
+        uNet::BufferBase* b = c.allocate();
+        while (handOver.load() != 0)
+            std::this_thread::yield();
+        handOver = b;
+    }
+    t.join();
+
+    c.flush();
+    ASSERT_EQ(0, p.statistics().numAllocated);
+}
+
+typedef uNet::SegregatedBufferPool<
+            boost::mpl::vector<uNet::buffer_class<64, 2>,
+                               uNet::buffer_class<256, 2>,
+                               uNet::buffer_class<1024, 1> > >
+        segregated_pool_t;
+typedef uNet::SegregatedBufferCache<segregated_pool_t, 2>
+        segregated_cache_t;
+
+TEST(SegregatedBufferCache, smallest_class_which_fits)
+{
+    segregated_pool_t p;
+    segregated_cache_t c(p);
+    ASSERT_EQ(0, c.size());
+
+    uNet::BufferBase* b = c.allocate(4);
+    ASSERT_EQ(64, b->capacity());
+    ASSERT_EQ(1, p.statistics(0).numAllocated);
+    b->dispose();
+
+    // The buffer stays in the cache of its class.
+    ASSERT_EQ(1, c.size());
+    ASSERT_EQ(1, p.statistics(0).numAllocated);
+    b = c.allocate(4);
+    ASSERT_EQ(64, b->capacity());
+    ASSERT_EQ(1, p.statistics(0).numAllocated);
+    b->dispose();
+
+    b = c.allocate(200);
+    ASSERT_EQ(256, b->capacity());
+    ASSERT_EQ(1, p.statistics(1).numAllocated);
+    b->dispose();
+
+    // Without a hint, a buffer from the largest class is allocated.
+    b = c.allocate();
+    ASSERT_EQ(1024, b->capacity());
+    b->dispose();
+    ASSERT_EQ(3, c.size());
+
+    c.flush();
+    ASSERT_EQ(0, c.size());
+    ASSERT_EQ(0, p.statistics().numAllocated);
+}
+
+TEST(SegregatedBufferCache, fall_back_to_larger_class)
+{
+    segregated_pool_t p;
+    segregated_cache_t c(p);
+
+    // Another thread holds the small buffers.
+    uNet::BufferBase* small1 = p.allocate(4);
+    uNet::BufferBase* small2 = p.allocate(4);
+    ASSERT_EQ(64, small2->capacity());
+
+    uNet::BufferBase* b = c.try_allocate(4);
+    ASSERT_TRUE(b != 0);
+    ASSERT_EQ(256, b->capacity());
+    b->dispose();
+
+    small1->dispose();
+    small2->dispose();
+    c.flush();
+    ASSERT_EQ(0, p.statistics().numAllocated);
+}
+
+TEST(SegregatedBufferCache, allocate_blocks_on_empty_pool)
+{
+    segregated_pool_t p;
+    segregated_cache_t c(p);
+
+    uNet::BufferBase* buffers[5];
+    for (unsigned idx = 0; idx < 5; ++idx)
+        buffers[idx] = p.allocate(4);
+    ASSERT_TRUE(p.try_allocate(4) == 0);
+
+    std::atomic<bool> allocated(false);
+    std::thread t([&] {
+        uNet::BufferBase* b = c.allocate(4);
+        allocated = true;
+        b->dispose();
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    ASSERT_FALSE(allocated);
+
+    // The thread waits for the fitting class.
+    buffers[0]->dispose();
+    t.join();
+    ASSERT_TRUE(allocated);
+
+    for (unsigned idx = 1; idx < 5; ++idx)
+        buffers[idx]->dispose();
+    c.flush();
+    ASSERT_EQ(0, p.statistics().numAllocated);
+}
+
+TEST(SegregatedBufferCache, zero_size_passes_through)
+{
+    segregated_pool_t p;
+    uNet::SegregatedBufferCache<segregated_pool_t, 0> c(p);
+
+    uNet::BufferBase* b = c.allocate(4);
+    ASSERT_EQ(64, b->capacity());
+    ASSERT_EQ(1, p.statistics(0).numAllocated);
+    b->dispose();
+    ASSERT_EQ(0, c.size());
+    ASSERT_EQ(0, p.statistics().numAllocated);
+}
@@ -0,0 +1,88 @@
+#include "../../bufferchain.hpp"
+#include "../../bufferpool.hpp"
+
+#include "gtest/gtest.h"
+
+#include <cstdint>
+
+// A buffer with 64 bytes of which 32 are reserved for the headers.
+typedef uNet::BufferPool<64, 8> pool_t;
+
+TEST(BufferChain, Initialization)
+{
+    pool_t p;
+    {
+        uNet::BufferChain chain(p);
+        ASSERT_EQ(0, chain.size());
+        ASSERT_EQ(1, chain.numSegments());
+        ASSERT_TRUE(chain.begin() == chain.end());
+        ASSERT_EQ(1, p.statistics().numAllocated);
+    }
+    ASSERT_EQ(0, p.statistics().numAllocated);
+}
+
+TEST(BufferChain, push_back_across_segments)
+{
+    pool_t p;
+    uNet::BufferChain chain(p);
+    for (std::uint32_t idx = 0; idx < 40; ++idx)
+        chain.push_back(idx);
+
+    // 32 bytes fit into the first segment, 64 bytes into every other one.
+    ASSERT_EQ(160, chain.size());
+    ASSERT_EQ(3, chain.numSegments());
+    ASSERT_EQ(3, p.statistics().numAllocated);
+    ASSERT_EQ(160, chain.head()->totalSize());
+
+    // Every element can be found when iterating over the bytes.
+    uNet::BufferChain::const_iterator iter = chain.begin();
+    for (std::uint32_t idx = 0; idx < 40; ++idx)
+    {
+        std::uint8_t bytes[sizeof(std::uint32_t)];
+        for (unsigned byte = 0; byte < sizeof(std::uint32_t); ++byte)
+            bytes[byte] = *iter++;
+        std::uint32_t value;
+        std::memcpy(&value, bytes, sizeof(value));
+        ASSERT_EQ(idx, value);
+    }
+    ASSERT_TRUE(iter == chain.end());
+}
+
+TEST(BufferChain, pop_front_across_segments)
+{
+    pool_t p;
+    uNet::BufferChain chain(p);
+    chain.push_back(std::uint8_t(0xAB));
+    for (std::uint32_t idx = 0; idx < 30; ++idx)
+        chain.push_back(idx);
+    ASSERT_EQ(3, chain.numSegments());
+
+    ASSERT_EQ(0xAB, chain.pop_front<std::uint8_t>());
+    // The elements are not aligned with the segment boundaries.
+    for (std::uint32_t idx = 0; idx < 30; ++idx)
+        ASSERT_EQ(idx, chain.pop_front<std::uint32_t>());
+
+    // The empty segments have been returned to the pool.
+    ASSERT_EQ(0, chain.size());
+    ASSERT_EQ(1, chain.numSegments());
+    ASSERT_EQ(1, p.statistics().numAllocated);
+}
+
+TEST(BufferChain, release)
+{
+    pool_t p;
+    uNet::BufferBase* head;
+    {
+        uNet::BufferChain chain(p);
+        for (std::uint32_t idx = 0; idx < 40; ++idx)
+            chain.push_back(idx);
+        head = chain.release();
+    }
+
+    // Disposing the head disposes the whole chain.
+    ASSERT_EQ(3, p.statistics().numAllocated);
+    head->push_front(std::uint16_t(0x1234));
+    ASSERT_EQ(162, head->totalSize());
+    head->dispose();
+    ASSERT_EQ(0, p.statistics().numAllocated);
+}
@@ -2,6 +2,8 @@
 
 #include "gtest/gtest.h"
 
+#include <vector>
+
 TEST(BufferPool, Constructor)
 {
     typedef uNet::BufferPool<256, 1> pool_t;
@@ -40,3 +42,127 @@ TEST(BufferPool, allocate_and_dispose)
         ASSERT_FALSE(p.empty());
     }
 }
+
+TEST(BufferPool, statistics)
+{
+    typedef uNet::BufferPool<256, 2> pool_t;
+    pool_t p;
+
+    uNet::BufferPoolStatistics stats = p.statistics();
+    ASSERT_EQ(2, stats.capacity);
+    ASSERT_EQ(0, stats.numAllocated);
+    ASSERT_EQ(0, stats.maxNumAllocated);
+    ASSERT_EQ(0, stats.numAllocationFailures);
+
+    pool_t::buffer_type* b1 = p.allocate();
+    pool_t::buffer_type* b2 = p.try_allocate();
+    ASSERT_TRUE(b2 != 0);
+    ASSERT_TRUE(p.try_allocate() == 0);
+    stats = p.statistics();
+    ASSERT_EQ(2, stats.numAllocated);
+    ASSERT_EQ(2, stats.maxNumAllocated);
+    ASSERT_EQ(1, stats.numAllocationFailures);
+
+    b1->dispose();
+    p.release(b2);
+    stats = p.statistics();
+    ASSERT_EQ(0, stats.numAllocated);
+    ASSERT_EQ(2, stats.maxNumAllocated);
+    ASSERT_EQ(1, stats.numAllocationFailures);
+}
+
+TEST(BufferPool, unlimited)
+{
+    typedef uNet::BufferPool<256, 0> pool_t;
+    pool_t p;
+    ASSERT_EQ(0, p.statistics().capacity);
+
+    // The pool grows in slabs of 16 buffers.
+    std::vector<pool_t::buffer_type*> buffers;
+    for (int i = 0; i < 40; ++i)
+    {
+        pool_t::buffer_type* b = p.try_allocate();
+        ASSERT_TRUE(b != 0);
+        ASSERT_FALSE(p.empty());
+        buffers.push_back(b);
+    }
+    uNet::BufferPoolStatistics stats = p.statistics();
+    ASSERT_EQ(48, stats.capacity);
+    ASSERT_EQ(40, stats.numAllocated);
+    ASSERT_EQ(0, stats.numAllocationFailures);
+
+    // Only slabs without a buffer are released.
+    for (int i = 0; i < 39; ++i)
+        buffers[i]->dispose();
+    p.trim();
+    ASSERT_EQ(16, p.statistics().capacity);
+
+    // Trimming keeps the requested number of free buffers.
+    buffers.resize(1);
+    for (int i = 0; i < 40; ++i)
+        buffers.push_back(p.allocate());
+    for (int i = 1; i < 41; ++i)
+        buffers[i]->dispose();
+    p.trim(20);
+    ASSERT_EQ(32, p.statistics().capacity);
+
+    buffers[0]->dispose();
+    ASSERT_EQ(0, p.statistics().numAllocated);
+    ASSERT_EQ(41, p.statistics().maxNumAllocated);
+}
+
+class RetransmittingGrabber : public uNet::BufferGrabber
+{
+public:
+    RetransmittingGrabber()
+        : grabbedBuffer(0)
+    {
+    }
+
+    virtual void grab(uNet::BufferBase& buffer)
+    {
+        grabbedBuffer = &buffer;
+    }
+
+    uNet::BufferBase* grabbedBuffer;
+};
+
+TEST(BufferMementoPool, memento_is_returned_to_pool)
+{
+    uNet::BufferPool<256, 1> bufferPool;
+    uNet::BufferMementoPool<2> mementoPool;
+    RetransmittingGrabber grabber;
+
+    uNet::BufferBase* b = bufferPool.allocate();
+    b->push_back(std::uint32_t(0x12345678));
+
+    for (int round = 0; round < 10; ++round)
+    {
+        uNet::BufferMemento* m1 = mementoPool.try_allocate(&grabber);
+        uNet::BufferMemento* m2 = mementoPool.try_allocate(&grabber);
+        ASSERT_TRUE(m1 != 0 && m2 != 0);
+        ASSERT_TRUE(mementoPool.empty());
+
+        // Two layers add a memento and a header each.
+        b->addMemento(*m1);
+        b->push_front(std::uint16_t(1));
+        b->addMemento(*m2);
+        b->push_front(std::uint16_t(2));
+
+        // Every disposal returns the buffer to the grabber and restores the
+        // iterators of the most recent memento.
+        b->dispose();
+        ASSERT_EQ(b, grabber.grabbedBuffer);
+        ASSERT_EQ(6, b->size());
+        ASSERT_FALSE(mementoPool.empty());
+
+        b->dispose();
+        ASSERT_EQ(4, b->size());
+        ASSERT_EQ(0x12345678, b->copy_front<std::uint32_t>());
+    }
+
+    // Without a memento, the buffer goes back to its pool.
+    ASSERT_TRUE(bufferPool.empty());
+    b->dispose();
+    ASSERT_FALSE(bufferPool.empty());
+}
@@ -0,0 +1,71 @@
+#include "../../segregatedbufferpool.hpp"
+
+#include "gtest/gtest.h"
+
+#include <boost/mpl/vector.hpp>
+
+typedef uNet::SegregatedBufferPool<
+            boost::mpl::vector<uNet::buffer_class<64, 2>,
+                               uNet::buffer_class<256, 2>,
+                               uNet::buffer_class<1024, 1> > > pool_t;
+
+TEST(SegregatedBufferPool, Constructor)
+{
+    pool_t p;
+    ASSERT_EQ(3, unsigned(pool_t::num_classes));
+    ASSERT_EQ(5, p.statistics().capacity);
+    ASSERT_EQ(2, p.statistics(0).capacity);
+    ASSERT_EQ(2, p.statistics(1).capacity);
+    ASSERT_EQ(1, p.statistics(2).capacity);
+    ASSERT_EQ(0, p.statistics().numAllocated);
+}
+
+TEST(SegregatedBufferPool, smallest_class_which_fits)
+{
+    pool_t p;
+
+    uNet::BufferBase* b = p.allocate(4);
+    ASSERT_EQ(64, b->capacity());
+    ASSERT_EQ(1, p.statistics(0).numAllocated);
+    b->dispose();
+
+    // The headroom is not available for the data.
+    b = p.allocate(64 - uNet::BufferBase::defaultHeadroom + 1);
+    ASSERT_EQ(256, b->capacity());
+    ASSERT_EQ(1, p.statistics(1).numAllocated);
+    b->dispose();
+
+    // Oversized requests are served from the largest class.
+    b = p.allocate(5000);
+    ASSERT_EQ(1024, b->capacity());
+    ASSERT_EQ(1, p.statistics(2).numAllocated);
+    b->dispose();
+
+    // Without a hint, a buffer from the largest class is allocated.
+    b = p.allocate();
+    ASSERT_EQ(1024, b->capacity());
+    b->dispose();
+
+    ASSERT_EQ(0, p.statistics().numAllocated);
+}
+
+TEST(SegregatedBufferPool, fall_back_to_larger_class)
+{
+    pool_t p;
+    uNet::BufferBase* buffers[5];
+    for (unsigned idx = 0; idx < 5; ++idx)
+    {
+        buffers[idx] = p.try_allocate(1);
+        ASSERT_TRUE(buffers[idx] != 0);
+    }
+    ASSERT_EQ(2, p.statistics(0).numAllocated);
+    ASSERT_EQ(2, p.statistics(1).numAllocated);
+    ASSERT_EQ(1, p.statistics(2).numAllocated);
+
+    ASSERT_TRUE(p.try_allocate(1) == 0);
+
+    for (unsigned idx = 0; idx < 5; ++idx)
+        buffers[idx]->dispose();
+    ASSERT_EQ(0, p.statistics().numAllocated);
+    ASSERT_EQ(5, p.statistics().maxNumAllocated);
+}
@@ -0,0 +1,233 @@
+#include "../../event.hpp"
+#include "../../lockfreeeventlist.hpp"
+
+#include "gtest/gtest.h"
+
+#include <thread>
+#include <vector>
+
+template <typename TEventList>
+struct event_list_capacity;
+
+template <template <unsigned> class TEventList, unsigned TCapacity>
+struct event_list_capacity<TEventList<TCapacity> >
+{
+    static const unsigned value = TCapacity;
+};
+
+template <typename TEventList>
+class EventListTest : public ::testing::Test
+{
+public:
+    typedef TEventList event_list_t;
+
+    // The number of events which can be allocated from the list. An
+    // unlimited list is only filled up to a fixed number of events.
+    static std::size_t numEvents()
+    {
+        return event_list_capacity<TEventList>::value
+               ? event_list_capacity<TEventList>::value : 25;
+    }
+};
+
+typedef ::testing::Types<uNet::EventList<10>,
+                         uNet::EventList<0>,
+                         uNet::LockFreeEventList<10>,
+                         uNet::LockFreeEventList<0> > EventListTypes;
+TYPED_TEST_CASE(EventListTest, EventListTypes);
+
+// Creates a unique event from a number.
+static uNet::Event createEvent(std::size_t number)
+{
+    return uNet::Event::createMessageSendEvent(
+                reinterpret_cast<uNet::BufferBase*>(number));
+}
+
+TYPED_TEST(EventListTest, retrieve_in_order)
+{
+    typename TestFixture::event_list_t l;
+
+    for (std::size_t round = 0; round < 3; ++round)
+    {
+        for (std::size_t idx = 1; idx <= 10; ++idx)
+            l.copy_enqueue(createEvent(idx));
+
+        for (std::size_t idx = 1; idx <= 10; ++idx)
+        {
+            uNet::Event ev = l.retrieve();
+            ASSERT_EQ(uNet::Event::MessageSend, ev.type());
+            ASSERT_EQ(idx, reinterpret_cast<std::size_t>(ev.buffer()));
+        }
+    }
+}
+
+TYPED_TEST(EventListTest, try_construct_and_enqueue)
+{
+    typename TestFixture::event_list_t l;
+
+    std::vector<uNet::Event*> events;
+    while (events.size() < TestFixture::numEvents())
+    {
+        uNet::Event* ev = l.try_construct();
+        if (!ev)
+            break;
+        events.push_back(ev);
+    }
+    ASSERT_EQ(TestFixture::numEvents(), events.size());
+    if (event_list_capacity<typename TestFixture::event_list_t>::value)
+    {
+        ASSERT_TRUE(l.try_construct() == 0);
+    }
+
+    for (std::size_t idx = 0; idx < events.size(); ++idx)
+    {
+        *events[idx] = createEvent(idx + 1);
+        l.enqueue(events[idx]);
+    }
+
+    for (std::size_t idx = 1; idx <= events.size(); ++idx)
+    {
+        uNet::Event ev = l.retrieve();
+        ASSERT_EQ(idx, reinterpret_cast<std::size_t>(ev.buffer()));
+    }
+
+    // All events have been returned to the pool.
+    uNet::Event* ev = l.try_construct();
+    ASSERT_TRUE(ev != 0);
+    l.destroy(ev);
+}
+
+TYPED_TEST(EventListTest, multiple_producers)
+{
+    typename TestFixture::event_list_t l;
+
+    const std::size_t numProducers = 4;
+    const std::size_t numEventsPerProducer = 1000;
+
+    std::vector<std::thread> producers;
+    for (std::size_t p = 0; p < numProducers; ++p)
+    {
+        producers.push_back(std::thread([&l, p] {
+            for (std::size_t idx = 0; idx < numEventsPerProducer; ++idx)
+                l.copy_enqueue(createEvent(p * numEventsPerProducer + idx + 1));
+        }));
+    }
+
+    // The events of every producer must be retrieved in the order in
+    // which they have been enqueued.
+    std::vector<std::size_t> lastIndex(numProducers, 0);
+    for (std::size_t count = 0; count < numProducers * numEventsPerProducer;
+         ++count)
+    {
+        uNet::Event ev = l.retrieve();
+        std::size_t number = reinterpret_cast<std::size_t>(ev.buffer()) - 1;
+        std::size_t p = number / numEventsPerProducer;
+        std::size_t idx = number % numEventsPerProducer + 1;
+        ASSERT_LT(p, numProducers);
+        ASSERT_EQ(lastIndex[p] + 1, idx);
+        lastIndex[p] = idx;
+    }
+
+    for (std::size_t p = 0; p < numProducers; ++p)
+        producers[p].join();
+}
+
+TYPED_TEST(EventListTest, retrieve_blocks_until_enqueue)
+{
+    typename TestFixture::event_list_t l;
+
+    std::thread producer([&l] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        l.copy_enqueue(createEvent(42));
+    });
+
+    uNet::Event ev = l.retrieve();
+    ASSERT_EQ(42, reinterpret_cast<std::size_t>(ev.buffer()));
+    producer.join();
+}
+
+TYPED_TEST(EventListTest, retrieve_all)
+{
+    typename TestFixture::event_list_t l;
+
+    for (std::size_t idx = 1; idx <= 5; ++idx)
+        l.copy_enqueue(createEvent(idx));
+
+    uNet::Event* ev = l.retrieve_all();
+    for (std::size_t idx = 1; idx <= 5; ++idx)
+    {
+        ASSERT_TRUE(ev != 0);
+        ASSERT_EQ(idx, reinterpret_cast<std::size_t>(ev->buffer()));
+        uNet::Event* next = ev->next();
+        l.destroy(ev);
+        ev = next;
+    }
+    ASSERT_TRUE(ev == 0);
+
+    // The list is empty now and can be filled again.
+    l.copy_enqueue(createEvent(6));
+    ev = l.retrieve_all();
+    ASSERT_TRUE(ev != 0);
+    ASSERT_EQ(6, reinterpret_cast<std::size_t>(ev->buffer()));
+    ASSERT_TRUE(ev->next() == 0);
+    l.destroy(ev);
+}
+
+TYPED_TEST(EventListTest, retrieve_and_retrieve_all)
+{
+    typename TestFixture::event_list_t l;
+
+    for (std::size_t idx = 1; idx <= 4; ++idx)
+        l.copy_enqueue(createEvent(idx));
+
+    // Retrieving a single event leaves the others in the list.
+    uNet::Event single = l.retrieve();
+    ASSERT_EQ(1, reinterpret_cast<std::size_t>(single.buffer()));
+
+    uNet::Event* ev = l.retrieve_all();
+    for (std::size_t idx = 2; idx <= 4; ++idx)
+    {
+        ASSERT_TRUE(ev != 0);
+        ASSERT_EQ(idx, reinterpret_cast<std::size_t>(ev->buffer()));
+        uNet::Event* next = ev->next();
+        l.destroy(ev);
+        ev = next;
+    }
+    ASSERT_TRUE(ev == 0);
+}
+
+TYPED_TEST(EventListTest, try_retrieve_all_for)
+{
+    typename TestFixture::event_list_t l;
+
+    // An empty list times out.
+    uNet::Event* ev = l.try_retrieve_all_for(std::chrono::milliseconds(5));
+    ASSERT_TRUE(ev == 0);
+
+    // The list is still usable after a timeout.
+    l.copy_enqueue(createEvent(1));
+    l.copy_enqueue(createEvent(2));
+    ev = l.try_retrieve_all_for(std::chrono::milliseconds(5));
+    ASSERT_TRUE(ev != 0);
+    ASSERT_EQ(1, reinterpret_cast<std::size_t>(ev->buffer()));
+    uNet::Event* next = ev->next();
+    l.destroy(ev);
+    ASSERT_TRUE(next != 0);
+    ASSERT_EQ(2, reinterpret_cast<std::size_t>(next->buffer()));
+    ASSERT_TRUE(next->next() == 0);
+    l.destroy(next);
+
+    // An event which is enqueued while waiting wakes up the consumer.
+    std::thread producer([&l] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        l.copy_enqueue(createEvent(3));
+    });
+    ev = l.try_retrieve_all_for(std::chrono::seconds(10));
+    producer.join();
+    ASSERT_TRUE(ev != 0);
+    ASSERT_EQ(3, reinterpret_cast<std::size_t>(ev->buffer()));
+    l.destroy(ev);
+
+    ev = l.try_retrieve_all_for(std::chrono::milliseconds(1));
+    ASSERT_TRUE(ev == 0);
+}
@@ -1,7 +1,13 @@
 #include "../../kernel.hpp"
+#include "../../protocol/simplemessageprotocol.hpp"
 
 #include <boost/type_traits/alignment_of.hpp>
 
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
 #include "gtest/gtest.h"
 
 class TestInterface : public uNet::NetworkInterface
@@ -68,6 +74,83 @@ TEST(Kernel, allocateBuffer)
     b->dispose();
 }
 
+struct buffer_class_traits : public uNet::default_kernel_traits
+{
+    typedef boost::mpl::vector<uNet::buffer_class<64, 4>,
+                               uNet::buffer_class<512, 2> >
+        buffer_class_list_t;
+};
+
+TEST(Kernel, allocateBuffer_with_size_hint)
+{
+    uNet::Kernel<buffer_class_traits> k;
+    uNet::BufferBase* small = k.allocateBuffer(8);
+    ASSERT_EQ(64, small->capacity());
+    uNet::BufferBase* large = k.allocateBuffer(300);
+    ASSERT_EQ(512, large->capacity());
+
+    ASSERT_EQ(1, k.bufferPoolStatistics(0).numAllocated);
+    ASSERT_EQ(1, k.bufferPoolStatistics(1).numAllocated);
+    ASSERT_EQ(6, k.bufferPoolStatistics().capacity);
+
+    small->dispose();
+    large->dispose();
+}
+
+struct unlimited_traits : public uNet::default_kernel_traits
+{
+    static const unsigned max_num_buffers = 0;
+    static const unsigned max_num_events = 0;
+};
+
+TEST(Kernel, unlimited_buffer_pool)
+{
+    uNet::Kernel<unlimited_traits> k;
+    std::vector<uNet::BufferBase*> buffers;
+    for (int i = 0; i < 100; ++i)
+    {
+        uNet::BufferBase* b = k.tryAllocateBuffer(0);
+        ASSERT_TRUE(b != 0);
+        buffers.push_back(b);
+    }
+    ASSERT_EQ(100, k.bufferPoolStatistics().numAllocated);
+
+    for (std::size_t i = 0; i < buffers.size(); ++i)
+        buffers[i]->dispose();
+    k.trimBufferPool();
+    ASSERT_EQ(0, k.bufferPoolStatistics().capacity);
+}
+
+struct smp_traits : public uNet::default_kernel_traits
+{
+    typedef boost::mpl::vector<uNet::SimpleMessageProtocol> protocol_list_t;
+};
+
+struct custom_header_traits : public uNet::default_kernel_traits
+{
+    typedef boost::mpl::vector<uNet::SimpleMessageProtocol> protocol_list_t;
+    static const unsigned custom_header_size = 20;
+};
+
+TEST(Kernel, headroom)
+{
+    ASSERT_EQ(sizeof(uNet::NetworkProtocolHeader),
+              uNet::Kernel<>::headroom);
+    ASSERT_EQ(sizeof(uNet::NetworkProtocolHeader)
+              + sizeof(uNet::SimpleMessageProtocolHeader),
+              uNet::Kernel<smp_traits>::headroom);
+    ASSERT_EQ(sizeof(uNet::NetworkProtocolHeader) + 20,
+              uNet::Kernel<custom_header_traits>::headroom);
+
+    uNet::Kernel<smp_traits> k;
+    uNet::BufferBase* b = k.allocateBuffer();
+    ASSERT_EQ(uNet::Kernel<smp_traits>::headroom, b->front_capacity());
+    b->push_front(uNet::SimpleMessageProtocolHeader());
+    b->push_front(uNet::NetworkProtocolHeader());
+    ASSERT_EQ(0, b->front_capacity());
+    b->dispose();
+}
+
 TEST(Kernel, addInterface)
 {
     uNet::Kernel<> k;
@@ -88,3 +171,675 @@ TEST(Kernel, custom_protocol_handler)
     k.protocolHandler<uNet::DefaultProtocolHandler>()->setCustomHandler(&ph);
     ASSERT_TRUE(k.protocolHandler<uNet::DefaultProtocolHandler>()->customHandler() == &ph);
 }
+
+// A protocol handler which counts the received packets.
+class CountingHandler
+{
+public:
+    CountingHandler()
+        : numReceived(0)
+    {
+    }
+
+    void receive(const uNet::ProtocolMetaData& /*metaData*/,
+                 uNet::BufferBase& packet)
+    {
+        ++numReceived;
+        packet.dispose();
+    }
+
+    void setKernel(uNet::KernelBase* /*kernel*/)
+    {
+    }
+
+    int numReceived;
+};
+
+// A handler which is dispatched via the table.
+template <std::uint8_t THeaderType>
+class TypedHandler : public CountingHandler
+{
+public:
+    static const std::uint8_t headerType = THeaderType;
+    static const std::size_t max_header_size = 0;
+
+    bool filter(const uNet::ProtocolMetaData& /*metaData*/) const
+    {
+        ADD_FAILURE() << "The filter of a typed handler must not be called";
+        return false;
+    }
+};
+
+// A handler which has to be asked via its filter.
+class UntypedHandler : public CountingHandler
+{
+public:
+    static const std::size_t max_header_size = 0;
+
+    bool filter(const uNet::ProtocolMetaData& metaData) const
+    {
+        return metaData.npHeader.nextHeader >= 10
+               && metaData.npHeader.nextHeader < 20;
+    }
+};
+
+TEST(ProtocolHandlerChain, dispatch)
+{
+    // The last protocol in the list is the first in the chain. Thus, the
+    // untyped handler takes precedence over TypedHandler<15> but not over
+    // TypedHandler<12>.
+    typedef uNet::make_protocol_handler_chain<
+                boost::mpl::vector<TypedHandler<3>, TypedHandler<15>,
+                                   UntypedHandler, TypedHandler<12>,
+                                   TypedHandler<200> >
+            >::type chain_t;
+    ASSERT_EQ(5u, unsigned(chain_t::num_handlers));
+
+    chain_t chain;
+    TestProtocolHandler custom;
+    chain.setCustomHandler(&custom);
+
+    uNet::BufferPool<64, 1> pool;
+    const std::uint8_t headerTypes[] = { 3, 12, 200, 11, 3, 15, 4 };
+    for (unsigned idx = 0; idx < sizeof(headerTypes); ++idx)
+    {
+        uNet::ProtocolMetaData metaData;
+        metaData.npHeader.nextHeader = headerTypes[idx];
+        chain.dispatch(metaData, *pool.allocate());
+    }
+
+    ASSERT_EQ(2, chain.cast<TypedHandler<3> >()->numReceived);
+    ASSERT_EQ(1, chain.cast<TypedHandler<12> >()->numReceived);
+    ASSERT_EQ(0, chain.cast<TypedHandler<15> >()->numReceived);
+    ASSERT_EQ(1, chain.cast<TypedHandler<200> >()->numReceived);
+    ASSERT_EQ(2, chain.cast<UntypedHandler>()->numReceived);
+    // The custom handler does not dispose the last packet.
+    ASSERT_TRUE(pool.empty());
+}
+
+// An interface which counts the sent packets and disposes them.
+class DisposingInterface : public uNet::NetworkInterface
+{
+public:
+    explicit DisposingInterface(uNet::NetworkInterfaceListener* l)
+        : uNet::NetworkInterface(l),
+          numBroadcasts(0),
+          numSends(0),
+          lastSourceAddress(0)
+    {
+    }
+
+    virtual void broadcast(uNet::BufferBase& packet)
+    {
+        ++numBroadcasts;
+        lastSourceAddress = packet.copy_front<uNet::NetworkProtocolHeader>()
+                                .sourceAddress.address();
+        packet.dispose();
+    }
+
+    virtual bool linkHasAddresses() const
+    {
+        return true;
+    }
+
+    virtual void send(const uNet::LinkLayerAddress& /*address*/,
+                      uNet::BufferBase& packet)
+    {
+        ++numSends;
+        packet.dispose();
+    }
+
+    std::atomic<int> numBroadcasts;
+    std::atomic<int> numSends;
+    std::atomic<std::uint16_t> lastSourceAddress;
+};
+
+// An interface which gathers chained packets.
+class GatheringInterface : public DisposingInterface
+{
+public:
+    explicit GatheringInterface(uNet::NetworkInterfaceListener* l)
+        : DisposingInterface(l),
+          lastPacketSize(0),
+          lastPayload(0)
+    {
+    }
+
+    virtual void broadcast(uNet::BufferBase& packet)
+    {
+        lastPacketSize = packet.totalSize();
+        lastPayload = packet.nextSegment();
+        DisposingInterface::broadcast(packet);
+    }
+
+    virtual bool supportsGather() const
+    {
+        return true;
+    }
+
+    std::atomic<std::size_t> lastPacketSize;
+    std::atomic<uNet::BufferBase*> lastPayload;
+};
+
+struct fast_neighbor_discovery_traits : public uNet::default_kernel_traits
+{
+    static const unsigned timer_tick_ms = 1;
+    static const unsigned neighbor_retransmit_time_ms = 20;
+    static const unsigned neighbor_reachable_time_ms = 50;
+    static const unsigned neighbor_delay_time_ms = 20;
+};
+
+// Returns the number of buffers which can be allocated from the kernel.
+template <typename TKernel>
+static unsigned numFreeBuffers(TKernel& k)
+{
+    std::vector<uNet::BufferBase*> buffers;
+    while (uNet::BufferBase* b = k.tryAllocateBuffer())
+        buffers.push_back(b);
+    for (std::size_t idx = 0; idx < buffers.size(); ++idx)
+        buffers[idx]->dispose();
+    return buffers.size();
+}
+
+TEST(Kernel, unreachable_neighbor_drops_queued_packets)
+{
+    typedef uNet::Kernel<fast_neighbor_discovery_traits> kernel_t;
+    kernel_t k;
+    DisposingInterface ifc(&k);
+    ifc.setNetworkAddress(uNet::NetworkAddress(0x0101, 0xFF00));
+    k.addInterface(&ifc);
+
+    for (int idx = 0; idx < 3; ++idx)
+    {
+        uNet::BufferBase* b = k.allocateBuffer();
+        b->push_back(idx);
+        k.send(0x0102, 2, *b);
+    }
+
+    // The neighbor never answers. After the solicitations, the entry is
+    // removed and the queued packets are disposed.
+    std::this_thread::sleep_for(std::chrono::milliseconds(
+        (fast_neighbor_discovery_traits::max_num_neighbor_solicitations + 2)
+        * fast_neighbor_discovery_traits::neighbor_retransmit_time_ms));
+
+    ASSERT_EQ(int(fast_neighbor_discovery_traits::max_num_neighbor_solicitations),
+              ifc.numBroadcasts);
+    ASSERT_EQ(0, ifc.numSends);
+    ASSERT_EQ(unsigned(fast_neighbor_discovery_traits::max_num_buffers),
+              numFreeBuffers(k));
+}
+
+TEST(Kernel, advertisment_sends_queued_packets)
+{
+    typedef uNet::Kernel<fast_neighbor_discovery_traits> kernel_t;
+    kernel_t k;
+    DisposingInterface ifc(&k);
+    ifc.setNetworkAddress(uNet::NetworkAddress(0x0101, 0xFF00));
+    k.addInterface(&ifc);
+
+    uNet::BufferBase* b = k.allocateBuffer();
+    b->push_back(1);
+    k.send(0x0102, 2, *b);
+
+    // Answer the solicitation.
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    ASSERT_EQ(1, ifc.numBroadcasts);
+
+    b = k.allocateBuffer();
+    uNet::NetworkControlProtocolMessageBuilder builder(*b);
+    builder.createNeighborAdvertisment(0x0102, true);
+    uNet::LinkLayerAddress lla;
+    lla.address = 0x22;
+    builder.addTargetLinkLayerAddressOption(lla);
+    uNet::NetworkProtocolHeader header;
+    header.sourceAddress = 0x0102;
+    header.destinationAddress = 0x0101;
+    header.nextHeader = 1;
+    header.length = b->size() + sizeof(uNet::NetworkProtocolHeader);
+    b->push_front(header);
+    k.notify(uNet::Event::createMessageReceiveEvent(&ifc, b));
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    ASSERT_EQ(1, ifc.numSends);
+
+    // The neighbor becomes stale. The next packet is sent right away and
+    // the neighbor is probed after the delay via unicast solicitations.
+    // Finally, the unresponsive neighbor is removed.
+    std::this_thread::sleep_for(std::chrono::milliseconds(
+        fast_neighbor_discovery_traits::neighbor_reachable_time_ms + 10));
+    b = k.allocateBuffer();
+    b->push_back(2);
+    k.send(0x0102, 2, *b);
+
+    // While the neighbor is probed, packets are still sent to its cached
+    // link-layer address.
+    std::this_thread::sleep_for(std::chrono::milliseconds(
+        fast_neighbor_discovery_traits::neighbor_delay_time_ms
+        + fast_neighbor_discovery_traits::neighbor_retransmit_time_ms / 2));
+    int numSends = ifc.numSends;
+    ASSERT_LT(2, numSends);
+    b = k.allocateBuffer();
+    b->push_back(3);
+    k.send(0x0102, 2, *b);
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    ASSERT_EQ(numSends + 1, ifc.numSends);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(
+        (fast_neighbor_discovery_traits::max_num_neighbor_solicitations + 2)
+        * fast_neighbor_discovery_traits::neighbor_retransmit_time_ms));
+    ASSERT_EQ(1, ifc.numBroadcasts);
+    ASSERT_EQ(3 + int(fast_neighbor_discovery_traits::max_num_neighbor_solicitations),
+              ifc.numSends);
+    ASSERT_EQ(unsigned(fast_neighbor_discovery_traits::max_num_buffers),
+              numFreeBuffers(k));
+
+    // A new packet starts a new discovery.
+    b = k.allocateBuffer();
+    b->push_back(4);
+    k.send(0x0102, 2, *b);
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    ASSERT_EQ(2, ifc.numBroadcasts);
+}
+
+struct forwarding_table_traits : public fast_neighbor_discovery_traits
+{
+    static const unsigned max_num_forwarding_table_chunks = 4;
+};
+
+TEST(Kernel, forwarding_table)
+{
+    typedef uNet::Kernel<forwarding_table_traits> kernel_t;
+    kernel_t k;
+    DisposingInterface ifc1(&k);
+    ifc1.setNetworkAddress(uNet::NetworkAddress(0x0101, 0xFF00));
+    k.addInterface(&ifc1);
+    DisposingInterface ifc2(&k);
+    ifc2.setNetworkAddress(uNet::NetworkAddress(0x0301, 0xFF00));
+    k.addInterface(&ifc2);
+
+    // The network 0x02xx is reached via a neighbor on the second interface
+    // except for a subnet, which needs a chunk in the forwarding table.
+    k.addStaticRoute(uNet::NetworkAddress(0x0200, 0xFF00), 0x0302);
+    k.addStaticRoute(uNet::NetworkAddress(0x0280, 0xFFC0), 0x0102);
+
+    // Sending to the network solicits the next neighbor on the interface
+    // of the route.
+    uNet::BufferBase* b = k.allocateBuffer();
+    b->push_back(1);
+    k.send(0x0205, 2, *b);
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    ASSERT_EQ(0, ifc1.numBroadcasts);
+    ASSERT_EQ(1, ifc2.numBroadcasts);
+
+    b = k.allocateBuffer();
+    b->push_back(2);
+    k.send(0x0285, 2, *b);
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    ASSERT_EQ(1, ifc1.numBroadcasts);
+    ASSERT_EQ(1, ifc2.numBroadcasts);
+
+    // Without the route, the destination cannot be reached at all.
+    ASSERT_TRUE(k.removeStaticRoute(uNet::NetworkAddress(0x0200, 0xFF00)));
+    ASSERT_FALSE(k.removeStaticRoute(uNet::NetworkAddress(0x0200, 0xFF00)));
+    b = k.allocateBuffer();
+    b->push_back(3);
+    k.send(0x0206, 2, *b);
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    ASSERT_EQ(1, ifc1.numBroadcasts);
+    ASSERT_EQ(1, ifc2.numBroadcasts);
+
+    // The queued packets are dropped together with the unreachable
+    // neighbors.
+    std::this_thread::sleep_for(std::chrono::milliseconds(
+        (forwarding_table_traits::max_num_neighbor_solicitations + 2)
+        * forwarding_table_traits::neighbor_retransmit_time_ms));
+    ASSERT_EQ(unsigned(forwarding_table_traits::max_num_buffers),
+              numFreeBuffers(k));
+}
+
+TEST(Kernel, solicitation_with_exhausted_buffer_pool)
+{
+    typedef uNet::Kernel<fast_neighbor_discovery_traits> kernel_t;
+    kernel_t k;
+    DisposingInterface ifc(&k);
+    ifc.setNetworkAddress(uNet::NetworkAddress(0x0101, 0xFF00));
+    k.addInterface(&ifc);
+
+    // The user holds every data buffer.
+    std::vector<uNet::BufferBase*> buffers;
+    while (uNet::BufferBase* b = k.tryAllocateBuffer())
+        buffers.push_back(b);
+    ASSERT_EQ(buffers.size(), k.bufferPoolStatistics().numAllocated);
+
+    // The solicitation is sent from the control buffer pool nevertheless.
+    k.send(0x0102, 2, *buffers.back());
+    buffers.pop_back();
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    ASSERT_EQ(1, ifc.numBroadcasts);
+    ASSERT_EQ(1, k.controlBufferPoolStatistics().maxNumAllocated);
+    ASSERT_EQ(0, k.controlBufferPoolStatistics().numAllocated);
+
+    for (std::size_t idx = 0; idx < buffers.size(); ++idx)
+        buffers[idx]->dispose();
+}
+
+TEST(Kernel, multicast_is_sent_on_all_interfaces)
+{
+    typedef uNet::Kernel<fast_neighbor_discovery_traits> kernel_t;
+    kernel_t k;
+    GatheringInterface ifc1(&k);
+    ifc1.setNetworkAddress(uNet::NetworkAddress(0x0101, 0xFF00));
+    k.addInterface(&ifc1);
+    DisposingInterface ifc2(&k);
+    ifc2.setNetworkAddress(uNet::NetworkAddress(0x0201, 0xFF00));
+    k.addInterface(&ifc2);
+    GatheringInterface ifc3(&k);
+    ifc3.setNetworkAddress(uNet::NetworkAddress(0x0301, 0xFF00));
+    k.addInterface(&ifc3);
+
+    uNet::BufferBase* b = k.allocateBuffer();
+    b->push_back(1);
+    k.send(0x8001, 2, *b);
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+    ASSERT_EQ(1, ifc1.numBroadcasts);
+    ASSERT_EQ(1, ifc2.numBroadcasts);
+    ASSERT_EQ(1, ifc3.numBroadcasts);
+    // Every interface uses its own address as source.
+    ASSERT_EQ(0x0101, ifc1.lastSourceAddress);
+    ASSERT_EQ(0x0201, ifc2.lastSourceAddress);
+    ASSERT_EQ(0x0301, ifc3.lastSourceAddress);
+    // The gathering interfaces share the payload.
+    ASSERT_EQ(b, ifc1.lastPayload);
+    ASSERT_EQ(b, ifc3.lastPayload);
+    ASSERT_EQ(sizeof(int) + sizeof(uNet::NetworkProtocolHeader),
+              ifc1.lastPacketSize);
+    ASSERT_EQ(0u, k.numSkippedMulticasts());
+    ASSERT_EQ(0, k.controlBufferPoolStatistics().maxNumAllocated);
+    ASSERT_EQ(unsigned(fast_neighbor_discovery_traits::max_num_buffers),
+              numFreeBuffers(k));
+}
+
+TEST(Kernel, multicast_skips_interfaces_without_buffer)
+{
+    typedef uNet::Kernel<fast_neighbor_discovery_traits> kernel_t;
+    kernel_t k;
+    GatheringInterface ifc1(&k);
+    ifc1.setNetworkAddress(uNet::NetworkAddress(0x0101, 0xFF00));
+    k.addInterface(&ifc1);
+    GatheringInterface ifc2(&k);
+    ifc2.setNetworkAddress(uNet::NetworkAddress(0x0201, 0xFF00));
+    k.addInterface(&ifc2);
+    GatheringInterface ifc3(&k);
+    ifc3.setNetworkAddress(uNet::NetworkAddress(0x0301, 0xFF00));
+    k.addInterface(&ifc3);
+
+    // The user holds all buffers except for one header.
+    std::vector<uNet::BufferBase*> buffers;
+    while (uNet::BufferBase* b = k.tryAllocateBuffer())
+        buffers.push_back(b);
+    buffers.back()->dispose();
+    buffers.pop_back();
+
+    buffers.back()->push_back(1);
+    k.send(0x8001, 2, *buffers.back());
+    buffers.pop_back();
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+    // The packet is sent on the first interface and the others are counted.
+    ASSERT_EQ(1, ifc1.numBroadcasts);
+    ASSERT_EQ(0, ifc2.numBroadcasts);
+    ASSERT_EQ(0, ifc3.numBroadcasts);
+    ASSERT_EQ(2u, k.numSkippedMulticasts());
+    ASSERT_EQ(0, k.controlBufferPoolStatistics().maxNumAllocated);
+
+    for (std::size_t idx = 0; idx < buffers.size(); ++idx)
+        buffers[idx]->dispose();
+    ASSERT_EQ(unsigned(fast_neighbor_discovery_traits::max_num_buffers),
+              numFreeBuffers(k));
+}
+
+struct buffer_cache_traits : public fast_neighbor_discovery_traits
+{
+    static const unsigned buffer_cache_size = 2;
+};
+
+TEST(Kernel, buffer_cache)
+{
+    typedef uNet::Kernel<buffer_cache_traits> kernel_t;
+    kernel_t k;
+    GatheringInterface ifc(&k);
+    ifc.setNetworkAddress(uNet::NetworkAddress(0x0101, 0xFF00));
+    k.addInterface(&ifc);
+    kernel_t::buffer_cache_t cache(k.bufferPool());
+
+    for (int idx = 0; idx < 3; ++idx)
+    {
+        uNet::BufferBase* b = cache.allocate(sizeof(int));
+        b->push_back(idx);
+        k.send(0x8001, 2, *b);
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    ASSERT_EQ(3, ifc.numBroadcasts);
+
+    // The sent packets have been returned to the cache by the event loop.
+    ASSERT_EQ(1u, cache.size());
+    ASSERT_EQ(unsigned(buffer_cache_traits::max_num_buffers) - 1,
+              numFreeBuffers(k));
+    cache.flush();
+    ASSERT_EQ(unsigned(buffer_cache_traits::max_num_buffers),
+              numFreeBuffers(k));
+}
+
+TEST(Kernel, chained_multicast_has_a_header_per_interface)
+{
+    typedef uNet::Kernel<fast_neighbor_discovery_traits> kernel_t;
+    kernel_t k;
+    GatheringInterface ifc1(&k);
+    ifc1.setNetworkAddress(uNet::NetworkAddress(0x0101, 0xFF00));
+    k.addInterface(&ifc1);
+    GatheringInterface ifc2(&k);
+    ifc2.setNetworkAddress(uNet::NetworkAddress(0x0201, 0xFF00));
+    k.addInterface(&ifc2);
+
+    uNet::BufferChain chain(k.bufferAllocator());
+    for (unsigned idx = 0; idx < fast_neighbor_discovery_traits::buffer_size;
+         ++idx)
+    {
+        chain.push_back(std::uint8_t(idx));
+    }
+    k.send(0x8001, 2, *chain.release());
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+    // The interfaces share the payload but not the header.
+    ASSERT_EQ(0x0101, ifc1.lastSourceAddress);
+    ASSERT_EQ(0x0201, ifc2.lastSourceAddress);
+    ASSERT_EQ(ifc1.lastPayload, ifc2.lastPayload);
+    ASSERT_EQ(fast_neighbor_discovery_traits::buffer_size
+              + sizeof(uNet::NetworkProtocolHeader),
+              ifc1.lastPacketSize);
+    ASSERT_EQ(fast_neighbor_discovery_traits::buffer_size
+              + sizeof(uNet::NetworkProtocolHeader),
+              ifc2.lastPacketSize);
+    ASSERT_EQ(0, k.controlBufferPoolStatistics().maxNumAllocated);
+    ASSERT_EQ(unsigned(fast_neighbor_discovery_traits::max_num_buffers),
+              numFreeBuffers(k));
+}
+
+TEST(Kernel, chained_packet_is_sent_by_gathering_interfaces)
+{
+    typedef uNet::Kernel<fast_neighbor_discovery_traits> kernel_t;
+    kernel_t k;
+    DisposingInterface ifc1(&k);
+    ifc1.setNetworkAddress(uNet::NetworkAddress(0x0101, 0xFF00));
+    k.addInterface(&ifc1);
+    GatheringInterface ifc2(&k);
+    ifc2.setNetworkAddress(uNet::NetworkAddress(0x0201, 0xFF00));
+    k.addInterface(&ifc2);
+
+    // Create a packet which is larger than a single buffer.
+    uNet::BufferChain chain(k.bufferAllocator());
+    for (unsigned idx = 0; idx < fast_neighbor_discovery_traits::buffer_size;
+         ++idx)
+    {
+        chain.push_back(std::uint8_t(idx));
+    }
+    ASSERT_EQ(2, chain.numSegments());
+    k.send(0x8001, 2, *chain.release());
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+    // Only the gathering interface can send the packet because it does not
+    // fit into a single buffer for a copy.
+    ASSERT_EQ(0, ifc1.numBroadcasts);
+    ASSERT_EQ(1, ifc2.numBroadcasts);
+    ASSERT_EQ(1u, k.numSkippedMulticasts());
+    ASSERT_EQ(fast_neighbor_discovery_traits::buffer_size
+              + sizeof(uNet::NetworkProtocolHeader),
+              ifc2.lastPacketSize);
+    ASSERT_EQ(unsigned(fast_neighbor_discovery_traits::max_num_buffers),
+              numFreeBuffers(k));
+}
+
+// A driver disposer which counts the returned frames.
+class FrameDisposer : public uNet::BufferDisposer
+{
+public:
+    FrameDisposer()
+        : numReturnedFrames(0)
+    {
+    }
+
+    virtual void dispose(uNet::BufferBase* /*buffer*/)
+    {
+        ++numReturnedFrames;
+    }
+
+    std::atomic<int> numReturnedFrames;
+};
+
+TEST(Kernel, receive_external_buffer)
+{
+    typedef uNet::Kernel<fast_neighbor_discovery_traits> kernel_t;
+    kernel_t k;
+    DisposingInterface ifc(&k);
+    ifc.setNetworkAddress(uNet::NetworkAddress(0x0101, 0xFF00));
+    k.addInterface(&ifc);
+
+    // A frame which has been received by the driver into its own memory.
+    uNet::NetworkProtocolHeader header;
+    header.sourceAddress = 0x0102;
+    header.destinationAddress = 0x0101;
+    header.nextHeader = 99;
+    header.length = sizeof(uNet::NetworkProtocolHeader) + 4;
+    std::uint8_t frame[64];
+    std::memcpy(frame, &header, sizeof(header));
+
+    FrameDisposer disposer;
+    uNet::ExternalBuffer b(frame, sizeof(frame), &disposer);
+    b.setData(0, header.length);
+    k.notify(uNet::Event::createMessageReceiveEvent(&ifc, &b));
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+    // Nobody handles the packet, so it is handed back to the driver.
+    ASSERT_EQ(1, disposer.numReturnedFrames);
+    ASSERT_EQ(unsigned(fast_neighbor_discovery_traits::max_num_buffers),
+              numFreeBuffers(k));
+}
+
+struct fast_smp_traits : public fast_neighbor_discovery_traits
+{
+    typedef boost::mpl::vector<uNet::SimpleMessageProtocol> protocol_list_t;
+};
+
+TEST(Kernel, receive_routed_congestion_notification)
+{
+    typedef uNet::Kernel<fast_smp_traits> kernel_t;
+    kernel_t k;
+    DisposingInterface ifc(&k);
+    ifc.setNetworkAddress(uNet::NetworkAddress(0x0101, 0xFF00));
+    k.addInterface(&ifc);
+    uNet::SendSocket socket(
+                *k.protocolHandler<uNet::SimpleMessageProtocol>(), 5);
+
+    uNet::BufferBase* b = k.allocateBuffer();
+    uNet::NetworkControlProtocolMessageBuilder builder(*b);
+    builder.createCongestionNotification(
+                uNet::SimpleMessageProtocol::headerType, 5);
+
+    // Unlike neighbor discovery messages, the notification may have been
+    // routed.
+    uNet::NetworkProtocolHeader header;
+    header.sourceAddress = 0x0305;
+    header.destinationAddress = 0x0101;
+    header.hopCount = 3;
+    header.nextHeader = 1;
+    header.length = sizeof(uNet::NetworkProtocolHeader) + b->size();
+    b->push_front(header);
+    k.notify(uNet::Event::createMessageReceiveEvent(&ifc, b));
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+    // The notification is passed on to the socket which has sent the
+    // dropped packet.
+    ASSERT_EQ(1u, k.numReceivedCongestionNotifications());
+    ASSERT_TRUE(socket.congested());
+    ASSERT_EQ(1u, socket.numCongestionNotifications());
+    ASSERT_EQ(unsigned(fast_smp_traits::max_num_buffers),
+              numFreeBuffers(k));
+}
+
+// A protocol which keeps its packets for a retransmission.
+class RetransmittingProtocol : public uNet::BufferGrabber
+{
+public:
+    RetransmittingProtocol()
+        : numGrabbedBuffers(0)
+    {
+    }
+
+    virtual void grab(uNet::BufferBase& buffer)
+    {
+        lastBuffer = &buffer;
+        ++numGrabbedBuffers;
+    }
+
+    std::atomic<uNet::BufferBase*> lastBuffer;
+    std::atomic<int> numGrabbedBuffers;
+};
+
+TEST(Kernel, buffer_is_returned_after_send)
+{
+    typedef uNet::Kernel<fast_neighbor_discovery_traits> kernel_t;
+    kernel_t k;
+    DisposingInterface ifc1(&k);
+    ifc1.setNetworkAddress(uNet::NetworkAddress(0x0101, 0xFF00));
+    k.addInterface(&ifc1);
+    DisposingInterface ifc2(&k);
+    ifc2.setNetworkAddress(uNet::NetworkAddress(0x0201, 0xFF00));
+    k.addInterface(&ifc2);
+
+    uNet::BufferMementoPool<1> mementoPool;
+    RetransmittingProtocol protocol;
+
+    uNet::BufferBase* b = k.allocateBuffer();
+    b->push_back(std::uint32_t(0xCAFE));
+    for (int transmission = 1; transmission <= 3; ++transmission)
+    {
+        b->addMemento(*mementoPool.allocate(&protocol));
+        k.send(0x8001, 2, *b);
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+        // After both interfaces have sent the packet, the protocol gets the
+        // buffer back without the network header.
+        ASSERT_EQ(transmission, protocol.numGrabbedBuffers);
+        ASSERT_EQ(b, protocol.lastBuffer);
+        ASSERT_EQ(sizeof(std::uint32_t), b->size());
+        ASSERT_EQ(0xCAFE, b->copy_front<std::uint32_t>());
+        ASSERT_FALSE(mementoPool.empty());
+    }
+    ASSERT_EQ(3, ifc1.numBroadcasts);
+    ASSERT_EQ(3, ifc2.numBroadcasts);
+
+    b->dispose();
+    ASSERT_EQ(unsigned(fast_neighbor_discovery_traits::max_num_buffers),
+              numFreeBuffers(k));
+}
@@ -0,0 +1,72 @@
+#include "../../destinationcache.hpp"
+
+#include "gtest/gtest.h"
+
+TEST(DestinationCache, Constructor)
+{
+    uNet::DestinationCache<4> dc;
+    ASSERT_TRUE(dc.lookup(0x0101) == 0);
+    ASSERT_TRUE(dc.lookup(0) == 0);
+}
+
+TEST(DestinationCache, cache)
+{
+    uNet::Neighbor n1, n2;
+
+    uNet::DestinationCache<4> dc;
+    dc.cache(0x0101, &n1, dc.generation());
+    dc.cache(0x0202, &n2, dc.generation());
+    ASSERT_TRUE(dc.lookup(0x0101) == &n1);
+    ASSERT_TRUE(dc.lookup(0x0202) == &n2);
+    ASSERT_TRUE(dc.lookup(0x0303) == 0);
+
+    // Updating an entry.
+    dc.cache(0x0101, &n2, dc.generation());
+    ASSERT_TRUE(dc.lookup(0x0101) == &n2);
+}
+
+TEST(DestinationCache, replace)
+{
+    uNet::Neighbor n1;
+
+    // A direct-mapped cache with a single entry keeps only the last
+    // destination.
+    uNet::DestinationCache<1> dc;
+    dc.cache(0x0101, &n1, dc.generation());
+    dc.cache(0x0202, &n1, dc.generation());
+    ASSERT_TRUE(dc.lookup(0x0101) == 0);
+    ASSERT_TRUE(dc.lookup(0x0202) == &n1);
+}
+
+TEST(DestinationCache, invalidate)
+{
+    uNet::Neighbor n1, n2;
+
+    uNet::DestinationCache<8> dc;
+    dc.cache(0x0101, &n1, dc.generation());
+    dc.cache(0x0202, &n2, dc.generation());
+    dc.invalidate();
+    ASSERT_TRUE(dc.lookup(0x0101) == 0);
+    ASSERT_TRUE(dc.lookup(0x0202) == 0);
+
+    // Entries of the new generation are valid.
+    dc.cache(0x0202, &n1, dc.generation());
+    ASSERT_TRUE(dc.lookup(0x0101) == 0);
+    ASSERT_TRUE(dc.lookup(0x0202) == &n1);
+}
+
+TEST(DestinationCache, invalidate_during_lookup)
+{
+    uNet::Neighbor n1;
+
+    // A neighbor which has been resolved before the cache has been
+    // invalidated is never returned and does not replace a valid entry.
+    uNet::Neighbor n2;
+    uNet::DestinationCache<1> dc;
+    std::uint32_t generation = dc.generation();
+    dc.invalidate();
+    dc.cache(0x0202, &n2, dc.generation());
+    dc.cache(0x0101, &n1, generation);
+    ASSERT_TRUE(dc.lookup(0x0101) == 0);
+    ASSERT_TRUE(dc.lookup(0x0202) == &n2);
+}
@@ -67,3 +67,95 @@ TEST(NeighborCache, createEntry)
     ASSERT_TRUE(nc.find(0x0202) == n2);
     ASSERT_TRUE(nc.find(0x0303) == n3);
 }
+
+TEST(NeighborCache, removeEntry)
+{
+    TestInterface ifc;
+
+    uNet::NeighborCache<3> nc;
+    uNet::Neighbor* n1 = nc.createEntry(0x0101, &ifc);
+    uNet::Neighbor* n2 = nc.createEntry(0x0202, &ifc);
+    uNet::Neighbor* n3 = nc.createEntry(0x0303, &ifc);
+    ASSERT_TRUE(n1 != 0 && n2 != 0 && n3 != 0);
+
+    // The cache is full.
+    ASSERT_TRUE(nc.createEntry(0x0404, &ifc) == 0);
+
+    nc.removeEntry(n2);
+    ASSERT_TRUE(nc.find(0x0101) == n1);
+    ASSERT_TRUE(nc.find(0x0202) == 0);
+    ASSERT_TRUE(nc.find(0x0303) == n3);
+
+    // The space of the removed entry can be re-used.
+    uNet::Neighbor* n4 = nc.createEntry(0x0404, &ifc);
+    ASSERT_TRUE(n4 != 0);
+    ASSERT_TRUE(nc.find(0x0404) == n4);
+
+    nc.removeEntry(n1);
+    nc.removeEntry(n4);
+    nc.removeEntry(n3);
+    ASSERT_TRUE(nc.find(0x0101) == 0);
+    ASSERT_TRUE(nc.find(0x0303) == 0);
+    ASSERT_TRUE(nc.find(0x0404) == 0);
+}
+
+TEST(NeighborCache, many_entries)
+{
+    TestInterface ifc;
+
+    uNet::NeighborCache<100> nc;
+    for (unsigned idx = 0; idx < 100; ++idx)
+        ASSERT_TRUE(nc.createEntry(0x0100 + idx, &ifc) != 0);
+    for (unsigned idx = 0; idx < 100; ++idx)
+        ASSERT_EQ(0x0100 + idx, nc.find(0x0100 + idx)->address());
+
+    // Remove every third entry. The remaining ones must still be found.
+    for (unsigned idx = 0; idx < 100; idx += 3)
+        nc.removeEntry(nc.find(0x0100 + idx));
+    for (unsigned idx = 0; idx < 100; ++idx)
+    {
+        if (idx % 3 == 0)
+            ASSERT_TRUE(nc.find(0x0100 + idx) == 0);
+        else
+            ASSERT_EQ(0x0100 + idx, nc.find(0x0100 + idx)->address());
+    }
+}
+
+TEST(NeighborCache, evict_least_recently_used_stale_entry)
+{
+    TestInterface ifc;
+
+    uNet::NeighborCache<3> nc;
+    uNet::Neighbor* n1 = nc.createEntry(0x0101, &ifc);
+    uNet::Neighbor* n2 = nc.createEntry(0x0202, &ifc);
+    uNet::Neighbor* n3 = nc.createEntry(0x0303, &ifc);
+    n1->setState(uNet::Neighbor::Stale);
+    n2->setState(uNet::Neighbor::Stale);
+    n3->setState(uNet::Neighbor::Stale);
+
+    // Use the first neighbor such that the second one is the least recently
+    // used one.
+    ASSERT_TRUE(nc.find(0x0101) == n1);
+
+    bool evicted = false;
+    uNet::Neighbor* n4 = nc.createEntry(0x0404, &ifc, &evicted);
+    ASSERT_TRUE(n4 != 0);
+    ASSERT_TRUE(evicted);
+    ASSERT_TRUE(nc.find(0x0101) == n1);
+    ASSERT_TRUE(nc.find(0x0202) == 0);
+    ASSERT_TRUE(nc.find(0x0303) == n3);
+    ASSERT_TRUE(nc.find(0x0404) == n4);
+
+    // Neighbors which are not stale or have pending packets are never
+    // evicted.
+    uNet::Buffer<16, 1> buffer;
+    n1->sendQueue().push_back(buffer);
+    n3->setState(uNet::Neighbor::Reachable);
+    ASSERT_TRUE(nc.createEntry(0x0505, &ifc, &evicted) == 0);
+    ASSERT_FALSE(evicted);
+    ASSERT_TRUE(nc.find(0x0101) == n1);
+    ASSERT_TRUE(nc.find(0x0303) == n3);
+    ASSERT_TRUE(nc.find(0x0404) == n4);
+
+    n1->sendQueue().clear();
+}
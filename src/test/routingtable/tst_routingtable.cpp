@@ -0,0 +1,126 @@
+#include "../../forwardingtable.hpp"
+#include "../../routingtable.hpp"
+
+#include "gtest/gtest.h"
+
+template <typename TRoutingTable>
+class RoutingTableTest : public ::testing::Test
+{
+public:
+    typedef TRoutingTable routing_table_t;
+};
+
+typedef ::testing::Types<uNet::RoutingTable<10>,
+                         uNet::ForwardingTable<10, 1>,
+                         uNet::ForwardingTable<10, 4>,
+                         uNet::ForwardingTable<10, 256> > RoutingTableTypes;
+TYPED_TEST_CASE(RoutingTableTest, RoutingTableTypes);
+
+TYPED_TEST(RoutingTableTest, empty_table)
+{
+    typename TestFixture::routing_table_t table;
+
+    // Without any route, every destination is reached directly.
+    ASSERT_EQ(0x0101, table.resolve(0x0101));
+    ASSERT_EQ(0x1234, table.resolve(0x1234));
+    ASSERT_EQ(0xFFFF, table.resolve(0xFFFF));
+}
+
+TYPED_TEST(RoutingTableTest, resolve)
+{
+    typename TestFixture::routing_table_t table;
+    table.addStaticRoute(uNet::NetworkAddress(0x0200, 0xFF00), 0x0101);
+    table.addStaticRoute(uNet::NetworkAddress(0x0300, 0xFFF0), 0x0102);
+
+    ASSERT_EQ(0x0101, table.resolve(0x0200));
+    ASSERT_EQ(0x0101, table.resolve(0x0255));
+    ASSERT_EQ(0x0102, table.resolve(0x0305));
+    ASSERT_EQ(0x0310, table.resolve(0x0310));
+    ASSERT_EQ(0x0405, table.resolve(0x0405));
+}
+
+TYPED_TEST(RoutingTableTest, same_as_linear_search)
+{
+    typename TestFixture::routing_table_t table;
+    uNet::RoutingTable<10> reference;
+
+    const uNet::NetworkAddress networks[] = {
+        uNet::NetworkAddress(0x0200, 0xFF00),
+        uNet::NetworkAddress(0x0310, 0xFFF0),
+        uNet::NetworkAddress(0x0340, 0xFFC0),
+        uNet::NetworkAddress(0x1000, 0xF000),
+        uNet::NetworkAddress(0x2345, 0xFFFF),
+        uNet::NetworkAddress(0x4000, 0xC000),
+        uNet::NetworkAddress(0x8100, 0xFF80)
+    };
+
+    for (unsigned route = 0; route < sizeof(networks) / sizeof(networks[0]);
+         ++route)
+    {
+        table.addStaticRoute(networks[route], 0x0100 + route);
+        reference.addStaticRoute(networks[route], 0x0100 + route);
+
+        for (unsigned address = 0; address <= 0xFFFF; ++address)
+            ASSERT_EQ(reference.resolve(address), table.resolve(address));
+    }
+}
+
+TYPED_TEST(RoutingTableTest, longest_prefix_match)
+{
+    typename TestFixture::routing_table_t table;
+
+    // The routes are added from the least to the most specific one.
+    table.addStaticRoute(uNet::NetworkAddress(0x0000, 0xC000), 0x0101);
+    table.addStaticRoute(uNet::NetworkAddress(0x2000, 0xF000), 0x0102);
+    table.addStaticRoute(uNet::NetworkAddress(0x2300, 0xFF00), 0x0103);
+    table.addStaticRoute(uNet::NetworkAddress(0x2340, 0xFFF0), 0x0104);
+
+    ASSERT_EQ(0x0104, table.resolve(0x2345));
+    ASSERT_EQ(0x0103, table.resolve(0x2355));
+    ASSERT_EQ(0x0102, table.resolve(0x2455));
+    ASSERT_EQ(0x0101, table.resolve(0x3455));
+}
+
+TYPED_TEST(RoutingTableTest, replace_route)
+{
+    typename TestFixture::routing_table_t table;
+    table.addStaticRoute(uNet::NetworkAddress(0x0200, 0xFF00), 0x0101);
+    table.addStaticRoute(uNet::NetworkAddress(0x0210, 0xFF00), 0x0102);
+    ASSERT_EQ(0x0102, table.resolve(0x0205));
+}
+
+TYPED_TEST(RoutingTableTest, remove_route)
+{
+    typename TestFixture::routing_table_t table;
+    table.addStaticRoute(uNet::NetworkAddress(0x2000, 0xF000), 0x0102);
+    table.addStaticRoute(uNet::NetworkAddress(0x2300, 0xFF00), 0x0103);
+
+    ASSERT_TRUE(table.removeStaticRoute(uNet::NetworkAddress(0x2300, 0xFF00)));
+    ASSERT_FALSE(table.removeStaticRoute(uNet::NetworkAddress(0x2300, 0xFF00)));
+    ASSERT_EQ(0x0102, table.resolve(0x2355));
+
+    ASSERT_TRUE(table.removeStaticRoute(uNet::NetworkAddress(0x2000, 0xF000)));
+    ASSERT_EQ(0x2355, table.resolve(0x2355));
+}
+
+TEST(RoutingTable, capacity)
+{
+    uNet::RoutingTable<3> table;
+    ASSERT_EQ(3, table.capacity());
+    for (unsigned idx = 0; idx < 3; ++idx)
+        table.addStaticRoute(uNet::NetworkAddress(0x0100 * (idx + 1), 0xFF00),
+                             0x0101);
+    ASSERT_EQ(3, table.numRoutes());
+
+    // Replacing a route does not need space.
+    table.addStaticRoute(uNet::NetworkAddress(0x0100, 0xFF00), 0x0102);
+    ASSERT_EQ(3, table.numRoutes());
+    ASSERT_EQ(0x0102, table.resolve(0x0105));
+
+    // A new route does not fit any longer.
+    ASSERT_FALSE(table.tryAddStaticRoute(uNet::NetworkAddress(0x0400, 0xFF00),
+                                         0x0101));
+    ASSERT_EQ(3, table.numRoutes());
+    ASSERT_TRUE(table.tryAddStaticRoute(uNet::NetworkAddress(0x0300, 0xFF00),
+                                        0x0102));
+}
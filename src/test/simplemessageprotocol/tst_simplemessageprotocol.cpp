@@ -0,0 +1,465 @@
+#include "../../bufferpool.hpp"
+#include "../../protocol/simplemessageprotocol.hpp"
+
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+typedef uNet::BufferPool<64, 4> pool_t;
+
+// Creates an SMP packet for the given destination port.
+static uNet::BufferBase* createPacket(pool_t& pool,
+                                      std::uint8_t destinationPort)
+{
+    uNet::BufferBase* packet = pool.allocate();
+    uNet::SimpleMessageProtocolHeader header
+            = uNet::SimpleMessageProtocolHeader();
+    header.sourcePort = 1;
+    header.destinationPort = destinationPort;
+    packet->push_front(header);
+    return packet;
+}
+
+// Dispatches a packet for the destinationPort to the protocol.
+static void receive(uNet::SimpleMessageProtocol& smp, pool_t& pool,
+                    std::uint8_t destinationPort,
+                    std::uint8_t sourcePort = 1,
+                    uNet::HostAddress sourceAddress = 0x0101)
+{
+    uNet::ProtocolMetaData metaData;
+    metaData.npHeader.nextHeader = uNet::SimpleMessageProtocol::headerType;
+    metaData.npHeader.sourceAddress = sourceAddress;
+    uNet::BufferBase* packet = createPacket(pool, destinationPort);
+    packet->begin()[0] = sourcePort;
+    smp.receive(metaData, *packet);
+}
+
+// Receives a pending packet from the connection and disposes it. Returns
+// true, if there has been a packet.
+static bool receiveAndDispose(uNet::ReceiveConnection& con)
+{
+    uNet::BufferBase* packet
+            = con.try_receive_for(std::chrono::milliseconds(0));
+    if (!packet)
+        return false;
+    packet->dispose();
+    return true;
+}
+
+TEST(SimpleMessageProtocol, demultiplex_by_port)
+{
+    uNet::SimpleMessageProtocol smp;
+    pool_t pool;
+
+    uNet::ReceiveSocket<1> socket5(smp, 5);
+    uNet::ReceiveSocket<1> socket200(smp, 200);
+    uNet::ReceiveConnection con5 = socket5.accept();
+    uNet::ReceiveConnection con200 = socket200.accept();
+
+    receive(smp, pool, 200);
+    receive(smp, pool, 5);
+    receive(smp, pool, 6);
+
+    uNet::BufferBase* packet = con5.try_receive_for(std::chrono::milliseconds(0));
+    ASSERT_TRUE(packet != 0);
+    packet->dispose();
+    packet = con200.try_receive_for(std::chrono::milliseconds(0));
+    ASSERT_TRUE(packet != 0);
+    packet->dispose();
+    ASSERT_TRUE(con5.try_receive_for(std::chrono::milliseconds(0)) == 0);
+
+    // The packet for the unbound port has been disposed.
+    ASSERT_EQ(0, pool.statistics().numAllocated);
+}
+
+TEST(SimpleMessageProtocol, port_can_only_be_bound_once)
+{
+    uNet::SimpleMessageProtocol smp;
+    uNet::ReceiveSocket<1> socket(smp, 5);
+    ASSERT_ANY_THROW(uNet::ReceiveSocket<1>(smp, 5));
+}
+
+TEST(SimpleMessageProtocol, port_is_released_when_socket_is_destroyed)
+{
+    uNet::SimpleMessageProtocol smp;
+    pool_t pool;
+    {
+        uNet::ReceiveSocket<1> socket(smp, 5);
+    }
+    receive(smp, pool, 5);
+    ASSERT_EQ(0, pool.statistics().numAllocated);
+
+    uNet::ReceiveSocket<1> socket(smp, 5);
+    uNet::ReceiveConnection con = socket.accept();
+    receive(smp, pool, 5);
+    uNet::BufferBase* packet = con.try_receive_for(std::chrono::milliseconds(0));
+    ASSERT_TRUE(packet != 0);
+    packet->dispose();
+}
+
+TEST(SimpleMessageProtocol, round_robin_delivery)
+{
+    uNet::SimpleMessageProtocol smp;
+    pool_t pool;
+    uNet::ReceiveSocket<3> socket(smp, 5);
+    socket.setDeliveryPolicy(uNet::ReceiveSocketBase::RoundRobin);
+    uNet::ReceiveConnection connections[] = { socket.accept(),
+                                              socket.accept(),
+                                              socket.accept() };
+
+    for (int round = 0; round < 2; ++round)
+    {
+        for (int idx = 0; idx < 3; ++idx)
+            receive(smp, pool, 5);
+        // Every connection has received exactly one packet.
+        for (int idx = 0; idx < 3; ++idx)
+        {
+            ASSERT_TRUE(receiveAndDispose(connections[idx]));
+            ASSERT_FALSE(receiveAndDispose(connections[idx]));
+        }
+    }
+}
+
+TEST(SimpleMessageProtocol, flow_hash_delivery)
+{
+    uNet::SimpleMessageProtocol smp;
+    pool_t pool;
+    uNet::ReceiveSocket<2> socket(smp, 5);
+    ASSERT_EQ(uNet::ReceiveSocketBase::FlowHash, socket.deliveryPolicy());
+    uNet::ReceiveConnection connections[] = { socket.accept(),
+                                              socket.accept() };
+
+    unsigned numPacketsPerConnection[2] = { 0, 0 };
+    for (unsigned sourcePort = 0; sourcePort < 32; ++sourcePort)
+    {
+        // All packets of a flow go to the same connection.
+        int connection = -1;
+        for (int packet = 0; packet < 3; ++packet)
+        {
+            receive(smp, pool, 5, sourcePort);
+            for (int idx = 0; idx < 2; ++idx)
+            {
+                if (receiveAndDispose(connections[idx]))
+                {
+                    ASSERT_TRUE(connection == -1 || connection == idx);
+                    connection = idx;
+                    ++numPacketsPerConnection[idx];
+                }
+            }
+        }
+        ASSERT_NE(-1, connection);
+    }
+
+    // Both connections receive some flows.
+    ASSERT_LT(0u, numPacketsPerConnection[0]);
+    ASSERT_LT(0u, numPacketsPerConnection[1]);
+}
+
+// A kernel which records the congestion notifications.
+class CongestionRecordingKernel : public uNet::KernelBase
+{
+public:
+    CongestionRecordingKernel()
+        : numNotifications(0),
+          lastPort(0)
+    {
+    }
+
+    virtual void send(uNet::HostAddress /*destination*/,
+                      std::uint8_t /*headerType*/, uNet::BufferBase& packet)
+    {
+        packet.dispose();
+    }
+
+    virtual void confirmReachability(uNet::HostAddress /*neighbor*/)
+    {
+    }
+
+    virtual void sendCongestionNotification(uNet::HostAddress destination,
+                                            std::uint8_t headerType,
+                                            std::uint8_t port)
+    {
+        ++numNotifications;
+        lastDestination = destination;
+        lastHeaderType = headerType;
+        lastPort = port;
+    }
+
+    int numNotifications;
+    uNet::HostAddress lastDestination;
+    std::uint8_t lastHeaderType;
+    std::uint8_t lastPort;
+};
+
+TEST(SimpleMessageProtocol, drop_newest)
+{
+    uNet::SimpleMessageProtocol smp;
+    pool_t pool;
+    uNet::ReceiveSocket<1> socket(smp, 5);
+    socket.setQueueLimits(2);
+    uNet::ReceiveConnection con = socket.accept();
+
+    for (std::uint8_t sourcePort = 1; sourcePort <= 3; ++sourcePort)
+        receive(smp, pool, 5, sourcePort);
+    ASSERT_EQ(2u, socket.statistics().numQueued);
+    ASSERT_EQ(1u, socket.statistics().numDropped);
+    ASSERT_EQ(1u, con.numDropped());
+
+    // The first two packets have been kept.
+    for (std::uint8_t sourcePort = 1; sourcePort <= 2; ++sourcePort)
+    {
+        uNet::BufferBase* packet
+                = con.try_receive_for(std::chrono::milliseconds(0));
+        ASSERT_TRUE(packet != 0);
+        ASSERT_EQ(sourcePort, packet->begin()[-8]);
+        packet->dispose();
+    }
+    ASSERT_EQ(0u, socket.statistics().numQueued);
+    ASSERT_EQ(0, pool.statistics().numAllocated);
+}
+
+TEST(SimpleMessageProtocol, drop_oldest)
+{
+    uNet::SimpleMessageProtocol smp;
+    pool_t pool;
+    uNet::ReceiveSocket<1> socket(smp, 5);
+    socket.setQueueLimits(2);
+    socket.setOverflowPolicy(uNet::ReceiveSocketBase::DropOldest);
+    uNet::ReceiveConnection con = socket.accept();
+
+    for (std::uint8_t sourcePort = 1; sourcePort <= 4; ++sourcePort)
+        receive(smp, pool, 5, sourcePort);
+    ASSERT_EQ(2u, socket.statistics().numQueued);
+    ASSERT_EQ(2u, socket.statistics().numDropped);
+
+    // The last two packets have been kept.
+    for (std::uint8_t sourcePort = 3; sourcePort <= 4; ++sourcePort)
+    {
+        uNet::BufferBase* packet
+                = con.try_receive_for(std::chrono::milliseconds(0));
+        ASSERT_TRUE(packet != 0);
+        ASSERT_EQ(sourcePort, packet->begin()[-8]);
+        packet->dispose();
+    }
+    ASSERT_TRUE(con.try_receive_for(std::chrono::milliseconds(0)) == 0);
+    ASSERT_EQ(0, pool.statistics().numAllocated);
+}
+
+TEST(SimpleMessageProtocol, socket_queue_limit)
+{
+    uNet::SimpleMessageProtocol smp;
+    pool_t pool;
+    uNet::ReceiveSocket<2> socket(smp, 5);
+    socket.setDeliveryPolicy(uNet::ReceiveSocketBase::RoundRobin);
+    socket.setQueueLimits(2, 3);
+    uNet::ReceiveConnection con1 = socket.accept();
+    uNet::ReceiveConnection con2 = socket.accept();
+
+    for (int idx = 0; idx < 4; ++idx)
+        receive(smp, pool, 5);
+    ASSERT_EQ(3u, socket.statistics().numQueued);
+    ASSERT_EQ(1u, socket.statistics().numDropped);
+    ASSERT_EQ(1u, con1.numDropped() + con2.numDropped());
+
+    // Closing a connection frees its queue.
+    con1.close();
+    con2.close();
+    ASSERT_EQ(0u, socket.statistics().numQueued);
+    ASSERT_EQ(0, pool.statistics().numAllocated);
+}
+
+TEST(SimpleMessageProtocol, backpressure)
+{
+    CongestionRecordingKernel kernel;
+    uNet::SimpleMessageProtocol smp;
+    smp.setKernel(&kernel);
+    pool_t pool;
+    uNet::ReceiveSocket<1> socket(smp, 5);
+    socket.setQueueLimits(1);
+    socket.setOverflowPolicy(uNet::ReceiveSocketBase::Backpressure);
+    uNet::ReceiveConnection con = socket.accept();
+
+    // Only the first dropped packet of a flow triggers a notification,
+    // which is addressed to the sender's port.
+    for (int idx = 0; idx < 3; ++idx)
+        receive(smp, pool, 5, 1, 0x0203);
+    ASSERT_EQ(1, kernel.numNotifications);
+    ASSERT_EQ(uNet::HostAddress(0x0203), kernel.lastDestination);
+    ASSERT_EQ(int(uNet::SimpleMessageProtocol::headerType),
+              int(kernel.lastHeaderType));
+    ASSERT_EQ(1, kernel.lastPort);
+    ASSERT_EQ(2u, socket.statistics().numDropped);
+
+    // Other flows are notified, too.
+    receive(smp, pool, 5, 2, 0x0203);
+    receive(smp, pool, 5, 1, 0x0304);
+    receive(smp, pool, 5, 2, 0x0203);
+    ASSERT_EQ(3, kernel.numNotifications);
+    ASSERT_EQ(uNet::HostAddress(0x0304), kernel.lastDestination);
+
+    // After a successful delivery, the next overflow is notified again.
+    ASSERT_TRUE(receiveAndDispose(con));
+    receive(smp, pool, 5);
+    receive(smp, pool, 5);
+    ASSERT_EQ(4, kernel.numNotifications);
+    ASSERT_EQ(4u, socket.statistics().numCongestionNotifications);
+
+    ASSERT_TRUE(receiveAndDispose(con));
+    ASSERT_EQ(0, pool.statistics().numAllocated);
+}
+
+TEST(SimpleMessageProtocol, congestion_notification_reaches_send_socket)
+{
+    uNet::SimpleMessageProtocol smp;
+    uNet::SendSocket socket1(smp, 7);
+    uNet::SendSocket socket2(smp, 8);
+    ASSERT_FALSE(socket1.congested());
+
+    smp.receiveCongestionNotification(0x0203, 7);
+    smp.receiveCongestionNotification(0x0203, 7);
+    smp.receiveCongestionNotification(0x0203, 9);
+    ASSERT_TRUE(socket1.congested());
+    ASSERT_EQ(2u, socket1.numCongestionNotifications());
+    ASSERT_FALSE(socket2.congested());
+    ASSERT_EQ(0u, socket2.numCongestionNotifications());
+
+    socket1.clearCongestion();
+    ASSERT_FALSE(socket1.congested());
+}
+
+TEST(Poller, reports_readable_connections)
+{
+    uNet::SimpleMessageProtocol smp;
+    pool_t pool;
+    uNet::ReceiveSocket<1> socket1(smp, 1);
+    uNet::ReceiveSocket<1> socket2(smp, 2);
+    uNet::ReceiveSocket<1> socket3(smp, 3);
+    uNet::ReceiveConnection con1 = socket1.accept();
+    uNet::ReceiveConnection con2 = socket2.accept();
+    uNet::ReceiveConnection con3 = socket3.accept();
+
+    uNet::Poller poller;
+    poller.add(con1);
+    poller.add(con2);
+    poller.add(con3);
+    ASSERT_EQ(3u, poller.size());
+    ASSERT_TRUE(poller.try_wait_for(std::chrono::milliseconds(0)) == 0);
+
+    receive(smp, pool, 3);
+    receive(smp, pool, 1);
+    receive(smp, pool, 3);
+
+    // The connections are reported in the order in which they have become
+    // readable and only once.
+    ASSERT_EQ(&con3, poller.wait());
+    ASSERT_EQ(&con1, poller.try_wait_for(std::chrono::milliseconds(0)));
+    ASSERT_TRUE(poller.try_wait_for(std::chrono::milliseconds(0)) == 0);
+
+    ASSERT_TRUE(receiveAndDispose(con1));
+    for (int idx = 0; idx < 2; ++idx)
+    {
+        uNet::BufferBase* packet = con3.try_receive();
+        ASSERT_TRUE(packet != 0);
+        packet->dispose();
+    }
+    ASSERT_TRUE(con3.try_receive() == 0);
+
+    // A drained connection becomes ready again.
+    receive(smp, pool, 3);
+    ASSERT_EQ(&con3, poller.wait());
+    ASSERT_TRUE(receiveAndDispose(con3));
+
+    poller.remove(con1);
+    poller.remove(con2);
+    poller.remove(con3);
+    ASSERT_EQ(0u, poller.size());
+}
+
+TEST(Poller, pending_packets_and_close)
+{
+    uNet::SimpleMessageProtocol smp;
+    pool_t pool;
+    uNet::ReceiveSocket<1> socket1(smp, 1);
+    uNet::ReceiveSocket<1> socket2(smp, 2);
+    uNet::ReceiveConnection con1 = socket1.accept();
+    uNet::ReceiveConnection con2 = socket2.accept();
+    receive(smp, pool, 1);
+    receive(smp, pool, 2);
+
+    // A connection with pending packets is ready immediately.
+    uNet::Poller poller;
+    poller.add(con1);
+    poller.add(con2);
+
+    // Closing a connection removes it from the poller.
+    con1.close();
+    ASSERT_EQ(1u, poller.size());
+    ASSERT_EQ(&con2, poller.wait());
+    ASSERT_TRUE(poller.try_wait_for(std::chrono::milliseconds(0)) == 0);
+
+    poller.remove(con2);
+    con2.close();
+    ASSERT_EQ(0, pool.statistics().numAllocated);
+}
+
+TEST(Poller, wakes_up_waiting_thread)
+{
+    uNet::SimpleMessageProtocol smp;
+    pool_t pool;
+    uNet::ReceiveSocket<1> socket(smp, 9);
+    uNet::ReceiveConnection con = socket.accept();
+    uNet::Poller poller;
+    poller.add(con);
+
+    std::atomic<uNet::ReceiveConnection*> ready(0);
+    std::thread waiter([&] {
+        ready = poller.wait();
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    ASSERT_TRUE(ready == 0);
+
+    receive(smp, pool, 9);
+    waiter.join();
+    ASSERT_EQ(&con, ready);
+    ASSERT_TRUE(receiveAndDispose(con));
+    poller.remove(con);
+}
+
+TEST(SimpleMessageProtocol, unbind_while_receiving)
+{
+    uNet::SimpleMessageProtocol smp;
+    pool_t pool;
+    std::atomic<bool> stop(false);
+
+    // The receiver plays the kernel's event loop.
+    std::thread receiver([&] {
+        uNet::ProtocolMetaData metaData;
+        while (!stop)
+        {
+            uNet::BufferBase* packet = pool.try_allocate();
+            if (!packet)
+                continue;
+            uNet::SimpleMessageProtocolHeader header
+                    = uNet::SimpleMessageProtocolHeader();
+            header.destinationPort = 7;
+            packet->push_front(header);
+            smp.receive(metaData, *packet);
+        }
+    });
+
+    for (int round = 0; round < 200; ++round)
+    {
+        uNet::ReceiveSocket<1> socket(smp, 7);
+        uNet::ReceiveConnection con = socket.accept();
+        uNet::BufferBase* packet
+                = con.try_receive_for(std::chrono::milliseconds(0));
+        if (packet)
+            packet->dispose();
+    }
+
+    stop = true;
+    receiver.join();
+    ASSERT_EQ(0, pool.statistics().numAllocated);
+}
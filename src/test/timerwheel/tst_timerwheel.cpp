@@ -0,0 +1,213 @@
+#include "../../timerwheel.hpp"
+
+#include "gtest/gtest.h"
+
+#include <cstdint>
+#include <vector>
+
+// Records the tick at which each timer expires.
+class RecordingListener : public uNet::TimerListener
+{
+public:
+    struct Expiry
+    {
+        uNet::Timer* timer;
+        std::uint32_t tick;
+    };
+
+    RecordingListener()
+        : now(0)
+    {
+    }
+
+    virtual void timerExpired(uNet::Timer& timer)
+    {
+        Expiry e = { &timer, now };
+        expiries.push_back(e);
+    }
+
+    std::uint32_t now;
+    std::vector<Expiry> expiries;
+};
+
+// Advances the wheel tick by tick such that the listener knows the time.
+template <typename TWheel>
+static void advanceTo(TWheel& wheel, RecordingListener& listener,
+                      std::uint32_t now)
+{
+    while (wheel.now() != now)
+    {
+        listener.now = wheel.now() + 1;
+        wheel.advance(wheel.now() + 1);
+    }
+}
+
+TEST(TimerWheel, initialization)
+{
+    uNet::TimerWheel<> wheel(42);
+    ASSERT_TRUE(wheel.empty());
+    ASSERT_EQ(42, wheel.now());
+    ASSERT_EQ(0xFFFFFFFF, wheel.ticksUntilNextExpiry());
+
+    uNet::Timer timer;
+    ASSERT_FALSE(timer.active());
+    ASSERT_TRUE(timer.listener() == 0);
+}
+
+TEST(TimerWheel, empty_wheel_jumps)
+{
+    uNet::TimerWheel<> wheel;
+    wheel.advance(123456);
+    ASSERT_EQ(123456, wheel.now());
+}
+
+TEST(TimerWheel, expire_at_exact_tick)
+{
+    // Use a tiny wheel with a range of 16 ticks such that timers have to
+    // be cascaded and re-inserted.
+    typedef uNet::TimerWheel<2, 2> wheel_t;
+    ASSERT_EQ(16, wheel_t::range);
+
+    for (std::uint32_t start = 0; start < 20; ++start)
+    {
+        for (std::uint32_t duration = 0; duration < 50; ++duration)
+        {
+            wheel_t wheel(start);
+            RecordingListener listener;
+            uNet::Timer timer;
+
+            wheel.start(timer, duration, &listener);
+            ASSERT_TRUE(timer.active());
+            ASSERT_FALSE(wheel.empty());
+
+            std::uint32_t expected = start + (duration ? duration : 1);
+            advanceTo(wheel, listener, expected + 20);
+
+            ASSERT_EQ(1, listener.expiries.size());
+            ASSERT_EQ(&timer, listener.expiries[0].timer);
+            ASSERT_EQ(expected, listener.expiries[0].tick);
+            ASSERT_FALSE(timer.active());
+            ASSERT_TRUE(wheel.empty());
+        }
+    }
+}
+
+TEST(TimerWheel, multiple_timers)
+{
+    uNet::TimerWheel<2, 3> wheel;
+    RecordingListener listener;
+    uNet::Timer timers[10];
+
+    for (unsigned idx = 0; idx < 10; ++idx)
+        wheel.start(timers[idx], 100 - 7 * idx, &listener);
+
+    advanceTo(wheel, listener, 200);
+    ASSERT_EQ(10, listener.expiries.size());
+    for (unsigned idx = 0; idx < 10; ++idx)
+    {
+        ASSERT_EQ(&timers[9 - idx], listener.expiries[idx].timer);
+        ASSERT_EQ(100 - 7 * (9 - idx), listener.expiries[idx].tick);
+    }
+    ASSERT_TRUE(wheel.empty());
+}
+
+TEST(TimerWheel, stop)
+{
+    uNet::TimerWheel<2, 2> wheel;
+    RecordingListener listener;
+    uNet::Timer t1, t2, t3;
+
+    wheel.start(t1, 5, &listener);
+    wheel.start(t2, 5, &listener);
+    wheel.start(t3, 5, &listener);
+
+    // Remove a timer from the middle of a slot.
+    wheel.stop(t2);
+    ASSERT_FALSE(t2.active());
+    // Stopping an inactive timer has no effect.
+    wheel.stop(t2);
+
+    advanceTo(wheel, listener, 10);
+    ASSERT_EQ(2, listener.expiries.size());
+    ASSERT_TRUE(wheel.empty());
+}
+
+TEST(TimerWheel, restart)
+{
+    uNet::TimerWheel<2, 2> wheel;
+    RecordingListener listener;
+    uNet::Timer timer;
+
+    wheel.start(timer, 5, &listener);
+    advanceTo(wheel, listener, 3);
+    wheel.start(timer, 5, &listener);
+    advanceTo(wheel, listener, 20);
+
+    ASSERT_EQ(1, listener.expiries.size());
+    ASSERT_EQ(8, listener.expiries[0].tick);
+}
+
+// A listener which restarts its timer a few times.
+class PeriodicListener : public uNet::TimerListener
+{
+public:
+    PeriodicListener(uNet::TimerWheel<2, 2>& wheel)
+        : m_wheel(wheel),
+          count(0)
+    {
+    }
+
+    virtual void timerExpired(uNet::Timer& timer)
+    {
+        ++count;
+        if (count < 5)
+            m_wheel.start(timer, 7, this);
+    }
+
+private:
+    uNet::TimerWheel<2, 2>& m_wheel;
+
+public:
+    int count;
+};
+
+TEST(TimerWheel, restart_from_listener)
+{
+    uNet::TimerWheel<2, 2> wheel;
+    PeriodicListener listener(wheel);
+    uNet::Timer timer;
+
+    wheel.start(timer, 7, &listener);
+    wheel.advance(34);
+    ASSERT_EQ(4, listener.count);
+    wheel.advance(35);
+    ASSERT_EQ(5, listener.count);
+    ASSERT_TRUE(wheel.empty());
+}
+
+TEST(TimerWheel, ticksUntilNextExpiry)
+{
+    uNet::TimerWheel<2, 2> wheel;
+    RecordingListener listener;
+    uNet::Timer timer;
+
+    wheel.start(timer, 3, &listener);
+    ASSERT_EQ(3, wheel.ticksUntilNextExpiry());
+    wheel.stop(timer);
+
+    // A timer in a higher level requires a wake-up when it is cascaded,
+    // which is never after its expiry.
+    wheel.start(timer, 13, &listener);
+    std::uint32_t hint = wheel.ticksUntilNextExpiry();
+    ASSERT_GE(13, hint);
+    ASSERT_LE(1, hint);
+
+    // Following the hints leads to the exact expiry.
+    while (!wheel.empty())
+    {
+        listener.now = wheel.now() + wheel.ticksUntilNextExpiry();
+        wheel.advance(listener.now);
+    }
+    ASSERT_EQ(1, listener.expiries.size());
+    ASSERT_EQ(13, listener.expiries[0].tick);
+}
@@ -0,0 +1,280 @@
+#ifndef UNET_TIMERWHEEL_HPP
+#define UNET_TIMERWHEEL_HPP
+
+#include "config.hpp"
+
+#include <boost/utility.hpp>
+
+#include <cstdint>
+
+namespace uNet
+{
+
+class Timer;
+
+//! A listener for timers.
+//! A TimerListener is notified when a Timer, which has been started with
+//! this listener, expires.
+class TimerListener
+{
+public:
+    //! Handles an expired timer.
+    //! This method is called when the \p timer has expired. The timer is
+    //! inactive when this method is invoked and may be restarted.
+    virtual void timerExpired(Timer& timer) = 0;
+};
+
+//! A timer.
+//! A Timer is an intrusive node which can be started in a TimerWheel. The
+//! timer does not need any storage apart from itself. Objects which need a
+//! timeout can derive from this class and recover themselves from the
+//! timer in TimerListener::timerExpired().
+class Timer : boost::noncopyable
+{
+public:
+    //! Creates an inactive timer.
+    Timer()
+        : m_listener(0),
+          m_expiry(0),
+          m_next(0),
+          m_pprev(0)
+    {
+    }
+
+    //! Checks if the timer is active.
+    //! Returns \p true, if the timer has been started and has neither
+    //! expired nor been stopped, yet.
+    bool active() const
+    {
+        return m_pprev != 0;
+    }
+
+    //! Returns the expiry tick.
+    //! Returns the tick at which the timer expires. The value is only
+    //! meaningful, if the timer is active.
+    std::uint32_t expiry() const
+    {
+        return m_expiry;
+    }
+
+    //! Returns the listener which is notified upon expiry.
+    TimerListener* listener() const
+    {
+        return m_listener;
+    }
+
+private:
+    //! The listener which is notified when the timer expires.
+    TimerListener* m_listener;
+    //! The tick at which the timer expires.
+    std::uint32_t m_expiry;
+    //! The next timer in the same slot.
+    Timer* m_next;
+    //! Points to the pointer which references this timer. This is either the
+    //! slot or the m_next member of the preceding timer.
+    Timer** m_pprev;
+
+    template <unsigned, unsigned>
+    friend class TimerWheel;
+};
+
+//! A hierarchical timer wheel.
+//! The TimerWheel manages an arbitrary number of timers with O(1) start and
+//! stop operations. The time is measured in ticks, which are advanced via
+//! advance(). The wheel consists of \p TNumLevels levels, each of which has
+//! 2^TSlotBits slots. The slots of the lowest level cover one tick each.
+//! The slots of every following level cover the complete range of the
+//! level below. When the time reaches a slot of a higher level, its timers
+//! are cascaded to the lower levels. The wheel covers
+//! 2^(TSlotBits * TNumLevels) ticks. Timers with a longer duration are
+//! parked in the farthest slot and re-inserted when this slot is reached.
+//!
+//! The wheel is not thread-safe. The kernel accesses it only from its event
+//! loop.
+template <unsigned TSlotBits = 4, unsigned TNumLevels = 4>
+class TimerWheel : boost::noncopyable
+{
+    static const unsigned numSlots = 1u << TSlotBits;
+    static const std::uint32_t slotMask = numSlots - 1;
+
+public:
+    //! The number of ticks which the wheel can cover without re-inserting
+    //! a timer.
+    static const std::uint32_t range
+        = TSlotBits * TNumLevels >= 32
+          ? 0xFFFFFFFF : (std::uint32_t(1) << (TSlotBits * TNumLevels));
+
+    //! Creates a timer wheel.
+    //! Creates a timer wheel whose current time is \p now.
+    explicit TimerWheel(std::uint32_t now = 0)
+        : m_now(now),
+          m_numTimers(0)
+    {
+        for (unsigned level = 0; level < TNumLevels; ++level)
+            for (unsigned slot = 0; slot < numSlots; ++slot)
+                m_slots[level][slot] = 0;
+    }
+
+    //! Advances the time.
+    //! Advances the current time of the wheel tick by tick up to \p now.
+    //! The listeners of all timers which expire on the way are notified.
+    void advance(std::uint32_t now)
+    {
+        while (m_now != now)
+        {
+            // If there is no active timer, we can jump to the new time
+            // right away.
+            if (m_numTimers == 0)
+            {
+                m_now = now;
+                return;
+            }
+
+            ++m_now;
+            cascade();
+
+            // Every timer in the current slot of the lowest level
+            // expires now.
+            Timer** slot = &m_slots[0][m_now & slotMask];
+            while (Timer* timer = *slot)
+            {
+                UNET_ASSERT(timer->m_expiry == m_now);
+                unlink(*timer);
+                timer->m_listener->timerExpired(*timer);
+            }
+        }
+    }
+
+    //! Checks if the wheel is empty.
+    //! Returns \p true, if no timer is active.
+    bool empty() const
+    {
+        return m_numTimers == 0;
+    }
+
+    //! Returns the current time.
+    std::uint32_t now() const
+    {
+        return m_now;
+    }
+
+    //! Starts a timer.
+    //! Starts the \p timer such that it expires in \p numTicks ticks. A
+    //! duration of zero is treated as one tick. When the timer expires, the
+    //! \p listener is notified. If the timer is already active, it is
+    //! restarted.
+    void start(Timer& timer, std::uint32_t numTicks, TimerListener* listener)
+    {
+        UNET_ASSERT(listener != 0);
+
+        if (timer.active())
+            stop(timer);
+
+        timer.m_listener = listener;
+        timer.m_expiry = m_now + (numTicks ? numTicks : 1);
+        insert(timer);
+    }
+
+    //! Stops a timer.
+    //! Stops the \p timer. Nothing happens, if the timer is not active.
+    void stop(Timer& timer)
+    {
+        if (timer.active())
+            unlink(timer);
+    }
+
+    //! Returns the number of ticks until the next action.
+    //! Returns a lower bound for the number of ticks until advance() has
+    //! to be called next. This is either the time until the next timer
+    //! expires or the time until timers have to be cascaded from a higher
+    //! level. If the wheel is empty, the maximum possible value is returned.
+    std::uint32_t ticksUntilNextExpiry() const
+    {
+        if (m_numTimers == 0)
+            return 0xFFFFFFFF;
+
+        for (std::uint32_t delta = 1; delta < numSlots; ++delta)
+            if (m_slots[0][(m_now + delta) & slotMask])
+                return delta;
+        return numSlots - (m_now & slotMask);
+    }
+
+private:
+    //! The current time.
+    std::uint32_t m_now;
+    //! The number of active timers.
+    std::uint32_t m_numTimers;
+    //! The slots of the wheel. Each slot is the head of a list of timers.
+    Timer* m_slots[TNumLevels][numSlots];
+
+    //! Moves the timers from higher levels to the lower ones.
+    void cascade()
+    {
+        for (unsigned level = 1; level < TNumLevels; ++level)
+        {
+            // A slot of this level is reached when the bits of all lower
+            // levels are zero.
+            if (m_now & ((std::uint32_t(1) << (TSlotBits * level)) - 1))
+                break;
+
+            Timer** slot = &m_slots[level][
+                               (m_now >> (TSlotBits * level)) & slotMask];
+            Timer* timer = *slot;
+            *slot = 0;
+            while (timer)
+            {
+                Timer* next = timer->m_next;
+                timer->m_pprev = 0;
+                --m_numTimers;
+                insert(*timer);
+                timer = next;
+            }
+        }
+    }
+
+    //! Inserts a timer in the slot which corresponds to its expiry time.
+    void insert(Timer& timer)
+    {
+        std::uint32_t delta = timer.m_expiry - m_now;
+        std::uint32_t position = timer.m_expiry;
+        if (delta >= range)
+        {
+            // The timer is too far in the future. Park it in the farthest
+            // slot from which it will be re-inserted later on.
+            delta = range - 1;
+            position = m_now + delta;
+        }
+
+        unsigned level = 0;
+        while (level < TNumLevels - 1
+               && delta >= (std::uint32_t(1) << (TSlotBits * (level + 1))))
+            ++level;
+
+        Timer** slot = &m_slots[level][
+                           (position >> (TSlotBits * level)) & slotMask];
+        timer.m_next = *slot;
+        if (timer.m_next)
+            timer.m_next->m_pprev = &timer.m_next;
+        timer.m_pprev = slot;
+        *slot = &timer;
+        ++m_numTimers;
+    }
+
+    //! Removes a timer from its slot.
+    void unlink(Timer& timer)
+    {
+        *timer.m_pprev = timer.m_next;
+        if (timer.m_next)
+            timer.m_next->m_pprev = timer.m_pprev;
+        timer.m_next = 0;
+        timer.m_pprev = 0;
+        --m_numTimers;
+    }
+};
+
+template <unsigned TSlotBits, unsigned TNumLevels>
+const std::uint32_t TimerWheel<TSlotBits, TNumLevels>::range;
+
+} // namespace uNet
+
+#endif // UNET_TIMERWHEEL_HPP
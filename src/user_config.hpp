@@ -23,4 +23,12 @@
 // Note: If UNET_ENABLE_ASSERT is not defined, this macro has no effect.
 // #define UNET_CUSTOM_ASSERT_HANDLER
 
+// If this macro is defined, the reference counters of the buffers are
+// protected by a mutex instead of being lock-free. This is only needed on
+// targets where an atomic read-modify-write of an unsigned is expensive.
+// Note: The macro affects nothing but the reference counters. The buffer
+// pool, the event list, the destination cache and the protocols still use
+// std::atomic, so the target has to provide it in any case.
+// #define UNET_NO_ATOMICS
+
 #endif // UNET_USER_CONFIG_HPP